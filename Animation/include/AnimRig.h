@@ -2,18 +2,30 @@
 
 #include "Skeleton.h"
 #include "Skin.h"
+#include "IKSolver.h"
 
 class AnimRig
 {
 public:
 	Skeleton* skeleton;
 	Skin* skin;
+	// Foot placement: each foot is an IK effector pulled up onto the ground when it sinks below
+	IKSolver* ik;
+	bool isFootIK = false;
+	float groundHeight = 0.0f;
 
 	AnimRig();
 	~AnimRig();
 
 	bool Load(const char* skelfile, const char* skinfile);
 	void Update(glm::mat4 parentW);
+	// The two halves of Update, for running them as separate tasks:
+	// pose the skeleton (including foot IK), then deform the skin
+	void UpdateSkeleton(glm::mat4 parentW);
+	void UpdateSkin();
+	// Make every joint whose name starts with prefix a foot (2-joint chain ending at its skin tip);
+	// the ground starts at the lowest foot of the current pose
+	void SetupFootIK(const char* prefix = "knee");
 	// default: draw attached skin without skel
 	void Draw(const glm::mat4& viewProjMtx, GLuint shader);
 };
\ No newline at end of file
@@ -13,6 +13,9 @@ public:
 	float playSpeed = 1.0f; // playback speed
 	std::vector<float> poses;
 	glm::mat4 rootTranslation;
+	// time the current poses were evaluated at; the clip is only evaluated again once curTime moves
+	float evaluatedTime = 0.0f;
+	bool isEvaluated = false;
 	const char* playMode = "To infinity!";
 
 	AnimationPlayer(AnimationClip* Clip, AnimRig* Rig);
@@ -20,4 +23,6 @@ public:
 	// evaluates current poses, set these poses, increments current time
 	// default play mode is walking till the end of the world
 	void Update(); 
+	void EvaluatePose();
+	void AdvanceTime();
 };
\ No newline at end of file
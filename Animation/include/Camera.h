@@ -19,6 +19,9 @@ public:
     void Reset();
 
     const glm::mat4 &GetViewProjectMtx() { return ViewProjectMtx; }
+    // Fraction of the viewport height a bounding sphere covers (about 1 when it fills the view);
+    // used to pick levels of detail
+    float ProjectedSize(const glm::vec3& center, float radius);
 
     // Viewing mode, change according to different models
     int mode;
@@ -36,4 +39,5 @@ public:
 
     // Computed data
     glm::mat4 ViewProjectMtx;
+    glm::vec3 EyePosition;
 };
\ No newline at end of file
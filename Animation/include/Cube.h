@@ -7,7 +7,7 @@
 class Cube {
 private:
     GLuint VAO;
-    GLuint VBO_positions, VBO_normals, EBO;
+    GLuint VBO_positions, VBO_normals, VBO_instances, EBO;
 
     glm::mat4 modelMtx; // model transformation matrix
     glm::vec3 ambientColor;
@@ -22,7 +22,9 @@ public:
     ~Cube();
 
     void drawCube(const glm::mat4& modelMtx, const glm::mat4& viewProjMtx, GLuint shader);
+    // Draw one copy of the cube per instance matrix with a single draw call
+    void drawCubeInstanced(const std::vector<glm::mat4>& instanceMtx, const glm::mat4& viewProjMtx, GLuint shader);
     void updateCube();
     void spinCube(float deg);
     void buildCube(glm::vec3 cubeMin = glm::vec3(-1, -1, -1), glm::vec3 cubeMax = glm::vec3(1, 1, 1));
-};
\ No newline at end of file
+};
@@ -2,7 +2,9 @@
 
 class DOF {
 public:
-    float DOFvalue;
+    // Points at this DOF's slot in its skeleton's flat DOF array once the skeleton is built,
+    // and at a local value before that
+    float* DOFvalue;
     float DOFmin, DOFmax;
 
     DOF();
@@ -11,4 +13,9 @@ public:
     void SetValue(float val);
     void SetMinMax(float min, float max);
     float GetValue();
+    // Move the current value into external storage and keep reading/writing it there
+    void BindStorage(float* storage);
+
+private:
+    float localValue;
 };
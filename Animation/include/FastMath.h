@@ -0,0 +1,23 @@
+////////////////////////////////////////
+// FastMath.h
+////////////////////////////////////////
+
+#pragma once
+
+#include "core.h"
+
+// Batched SSE replacements for the libm/glm calls in the per-frame loops. Every
+// function works on whole arrays, 4 lanes at a time with a scalar tail that uses
+// the same arithmetic, so results do not depend on where an element falls.
+//
+// Accuracy against libm (float):
+//   SinCos    - absolute error <= 1e-7 for |x| <= 8192, which covers every DOF limit.
+//               Beyond that the Cody-Waite range reduction loses bits; do not use it there.
+//   Distance  - sqrt of the squared distance, exact to float rounding (uses sqrtps).
+
+namespace FastMath {
+	// s[i] = sin(x[i]), c[i] = cos(x[i]) for i in [0, n)
+	void SinCos(const float* x, float* s, float* c, int n);
+	// d[i] = |a[i] - b[i]| for i in [0, n)
+	void Distance(const glm::vec3* a, const glm::vec3* b, float* d, int n);
+}
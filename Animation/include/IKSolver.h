@@ -0,0 +1,89 @@
+////////////////////////////////////////
+// IKSolver.h
+////////////////////////////////////////
+
+#pragma once
+
+#include "core.h"
+#include "Skeleton.h"
+
+// The IKSolver pulls end effectors (points fixed in some joint's space) toward world
+// space targets by changing the DOFs of the few joints above each effector. The main
+// solver is damped least squares on the stacked position Jacobian of all effectors.
+// If it stalls, every chain that is still off target gets a few FABRIK passes whose
+// joint positions are turned back into DOF angles, kept only if they get closer. DOF
+// limits are enforced after every step, and solving stops once all effectors are within
+// tolerance, after maxIterations, or when the time budget is spent.
+//
+// The solver gathers the DOFs of all chain joints into its own contiguous arrays, works
+// on those, and writes them back to skeleton->DOFvalues. It reads the pose's world
+// matrices from skeleton->poseW (call Skeleton::ComputePoseW first), so the joints are
+// untouched until Skeleton::Update commits the result.
+
+struct IKEffector {
+	int joint;             // index into skeleton->joints
+	glm::vec3 localOffset; // effector point in the joint's space
+	glm::vec3 target;      // world space target
+	int chainLength;       // # joints solved, counting up from the effector joint
+	bool enabled;
+};
+
+struct IKStats {
+	int iterations;
+	float error;           // largest remaining effector distance
+	float microseconds;
+	bool usedFallback;     // FABRIK ran and was kept
+};
+
+class IKSolver {
+public:
+	std::vector<IKEffector> effectors;
+	float damping = 0.05f;            // lambda in (J * J^T + lambda^2 * I)
+	float tolerance = 0.001f;         // effector distance that counts as converged
+	float maxStep = 0.2f;             // largest effector correction asked for per iteration
+	int maxIterations = 30;
+	float budgetMicroseconds = 100.0f;
+	bool warmStart = true;            // add last frame's correction to the current pose instead of starting from it
+	bool useFallback = true;          // FABRIK passes when DLS stalls
+	IKStats stats;
+
+	IKSolver(Skeleton* skel);
+	~IKSolver();
+
+	// Returns the index of the new effector; chains are rebuilt on the next Solve
+	int AddEffector(int joint, glm::vec3 localOffset, int chainLength);
+	void Solve();
+	// World position of an effector in skeleton->poseW
+	glm::vec3 GetEffectorPosition(int effector);
+
+private:
+	Skeleton* skeleton;
+	bool isChainBuilt;
+
+	// Joints touched by any chain ("slots"), in skeleton order so parents come first
+	std::vector<int> slotJoint;
+	std::vector<int> slotParent;            // slot of the parent joint, -1 if it is outside every chain
+	std::vector<glm::vec3> slotOffset;
+	std::vector<glm::mat4> slotBaseW;       // world matrix of an outside parent, fixed during a solve
+	std::vector<glm::mat4> slotW;           // world matrices computed from theta
+	// Chain DOFs, 3 per slot
+	std::vector<float> theta, thetaMin, thetaMax, sines, cosines;
+	std::vector<float> pose;                // the DOFs as the solve found them (the animated pose)
+	std::vector<float> prevTheta, prevPose; // last frame's solution & the pose it started from
+	std::vector<char> prevValid;            // per slot, prevTheta & prevPose hold last frame's solve
+	std::vector<float> stalledTheta;        // DLS result, kept if the FABRIK fallback does worse
+	// Slots of each effector's chain, ordered from the chain root down to the effector joint
+	std::vector<std::vector<int>> chainSlots;
+	// Scratch for the least squares step
+	std::vector<float> J, A, rhs;
+	// Scratch for ComputeError, one entry per active effector
+	std::vector<glm::vec3> effectorPos, effectorTarget;
+	std::vector<float> effectorDist;
+
+	void BuildChains();
+	void ForwardKinematics(int firstSlot = 0);
+	glm::vec3 EffectorWorld(int effector);
+	float ComputeError(const std::vector<int>& active, float* err);
+	void DampedLeastSquaresStep(const std::vector<int>& active, const float* err);
+	void FabrikChain(int effector);
+};
@@ -2,7 +2,6 @@
 #include "core.h"
 #include "DOF.h"
 #include "Tokenizer.h"
-#include "Cube.h"
 #include <vector>
 
 class Joint {
@@ -13,9 +12,10 @@ public:
 	glm::vec3 pose; // default pose for DOFs
 	glm::mat4 L;
 	glm::mat4 W;
-	Cube* cube;
+	glm::mat4 boxMtx; // scale & offset that fit the shared unit cube to [boxmin, boxmax]
 	std::vector<DOF*> JointDOF;
 	std::vector<Joint*> children;
+	Joint* parent;
 	glm::mat4 inverseB;  // inverse of binding matrix for each joint
 	char JointName[256];
 
@@ -23,10 +23,13 @@ public:
 	~Joint();
 
 	bool Load(Tokenizer* tknizer);
-	void Update(glm::mat4 parentW);
+	// Compute L & W from this joint's 3 DOFs, given their precomputed sines & cosines;
+	// children are not visited, the skeleton updates joints in depth-first order
+	void Update(const glm::mat4& parentW, const float* sines, const float* cosines);
+	// Local matrix T * Rz * Ry * Rx for a joint offset and the sines & cosines of its 3 DOFs
+	static glm::mat4 ComputeLocal(const glm::vec3& offset, const float* sines, const float* cosines);
 	void ResetAll();
 	void AddChild(Joint* newChild);
-	void Draw(const glm::mat4& viewProjMtx, GLuint shader);
 	// Get subsequent joints including the current one and put them in a vector
 	// Pass in joint vector by reference, should be std::vector<Joint*>*
 	void BuildJointVector(std::vector<Joint*>* joints_ref);
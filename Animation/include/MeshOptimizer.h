@@ -0,0 +1,43 @@
+////////////////////////////////////////
+// MeshOptimizer.h
+////////////////////////////////////////
+
+#pragma once
+
+#include "core.h"
+#include <vector>
+#include <functional>
+
+// Load-time reordering of indexed triangle meshes:
+//   OptimizeVertexCache - reorders triangles so consecutive ones share vertices still in the
+//                         GPU's post-transform cache (Tipsify, Sander et al. 2007; linear time)
+//   OptimizeVertexFetch - renumbers vertices in order of first use, so the triangle walk (and
+//                         any per-vertex loop) reads vertex data front to back
+//   SimplifyLODs        - quadric error simplification into coarser levels of detail
+// Run the cache pass first; the fetch pass keeps the triangle order and only renames vertices.
+
+namespace MeshOptimizer {
+	// Post-transform cache entries assumed by the optimizer and by ComputeACMR
+	const int CACHE_SIZE = 16;
+
+	// Average cache miss ratio: vertices transformed per triangle with a FIFO cache of cacheSize
+	// (0.5 is the limit for large regular meshes, 3 means no reuse at all)
+	float ComputeACMR(const std::vector<unsigned int>& indices, int vertexNum, int cacheSize = CACHE_SIZE);
+
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, int vertexNum, int cacheSize = CACHE_SIZE);
+
+	// Rewrites indices and returns the old -> new vertex map; unreferenced vertices go last
+	std::vector<int> OptimizeVertexFetch(std::vector<unsigned int>& indices, int vertexNum);
+
+	// Garland-Heckbert quadric error simplification with half-edge collapses: a collapse removes one
+	// vertex and moves its triangles onto a neighbour, so every level uses a subset of the original
+	// vertices, with their attributes (e.g. skin weights) unchanged. Collapses that flip a triangle
+	// or pinch the surface are skipped; open borders are kept in place by extra quadrics.
+	// attributeCost(u, v), if set, is a unitless penalty for merging u into v (scaled by the edge
+	// length and triangle size, so it competes with the geometric error on flat regions).
+	// lodIndices[0] is indices; lodIndices[k] has about triangleRatios[k - 1] of its triangles.
+	// vertexLOD[v] is the coarsest level that still uses v.
+	void SimplifyLODs(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+		const std::vector<float>& triangleRatios, const std::function<float(int, int)>& attributeCost,
+		std::vector<std::vector<unsigned int>>& lodIndices, std::vector<int>& vertexLOD);
+}
@@ -2,6 +2,7 @@
 #include "Joint.h"
 #include "Core.h"
 #include "Tokenizer.h"
+#include "Cube.h"
 #include <vector>
 
 class Skeleton {
@@ -10,12 +11,41 @@ public:
 	// Joints contained in the whole skeleton
 	// used for linking joints with skin when setting weights
 	std::vector<Joint*> joints; 
+	// Flat DOF storage, three per joint in the order of joints; every DOF of the
+	// skeleton reads and writes its value here, limits are mirrored for batch clamping
+	std::vector<float> DOFvalues;
+	std::vector<float> DOFmins;
+	std::vector<float> DOFmaxs;
+	// Sines & cosines of DOFvalues, recomputed in one batch every update
+	std::vector<float> DOFsines;
+	std::vector<float> DOFcosines;
+	// Unit cube shared by every skeleton; each joint box is one instance of it
+	static Cube* boxMesh;
+	// Per-joint box matrices uploaded for the instanced draw
+	std::vector<glm::mat4> boxInstanceMtx;
+	// Bumped each time Update recomputes the joints, which it only does when a DOF value or the
+	// parent matrix differs from the last recompute; users cache it to skip work on a still pose
+	int generation = 0;
+	std::vector<float> updatedDOFvalues;
+	glm::mat4 updatedParentW;
+	// World matrix of every joint for the current DOFs, from ComputePoseW; the joints and the
+	// generation are left alone, so a solver can look at a pose before it is committed by Update
+	std::vector<glm::mat4> poseW;
+	glm::mat4 poseParentW;
+	std::vector<float> poseDOFvalues;
+	// Index of each joint's parent in joints, -1 for the root
+	std::vector<int> jointParent;
 
 	Skeleton();
 	~Skeleton();
 
 	bool Load(const char* filename = "assets/test.skel");
 	void Update(glm::mat4 parentW);
+	// Fill poseW for the current DOFs; a no-op while the DOFs & parentW match its last run
+	void ComputePoseW(glm::mat4 parentW);
 	void Draw(const glm::mat4& viewProjMtx, GLuint shader);
 	void BuildJointVector();
+	void BuildDOFArrays();
+	// Clamp a pose (3 values per joint) against the DOF limits and write it into DOFvalues
+	void SetPose(const float* pose);
 };
\ No newline at end of file
@@ -1,33 +1,151 @@
 #pragma once
-#include "Vertex.h"
+#include "Core.h"
 #include "Tokenizer.h"
 #include <vector>
+#include <cstdint>
 #include "Skeleton.h"
+#include "SkinningKernel.h"
+#include "TaskScheduler.h"
+
+// Influences stored per vertex; extra ones are pruned at load (define as 8 for wide falloffs)
+#ifndef SKIN_MAX_INFLUENCES
+#define SKIN_MAX_INFLUENCES 4
+#endif
+// Reorder triangles & vertices at load for the vertex cache and for skinning locality (0 keeps file order)
+#ifndef SKIN_OPTIMIZE_MESH
+#define SKIN_OPTIMIZE_MESH 1
+#endif
+// Levels of detail built at load (1 disables them); each has about half the triangles of the last
+#ifndef SKIN_LOD_NUM
+#define SKIN_LOD_NUM 4
+#endif
+// Projected size (fraction of the viewport height) below which LOD 1 is used; each halving goes one level coarser
+#define SKIN_LOD_SCREEN_SIZE 0.4f
+// Copies of the skinned mesh the CPU and GPU rotate through
+#define SKIN_RING_SEGMENTS 3
+// GPU skinning limits: palette size (must match MAX_SKIN_JOINTS in shader.glsl; 256 mat4 is the
+// 16 KB uniform block every GL 3.3 driver supports) and influences per vertex (one ivec4 + vec4)
+#define SKIN_MAX_GPU_JOINTS 256
+#define SKIN_GPU_INFLUENCES 4
 
 class Skin
 {
 public:
 	int vertexNum;
-	std::vector<Vertex*> vertices;
 	// The skeleton associated with this skin; used for linking joints
 	Skeleton* skeleton; 
 
-	// shader-related
-	GLuint VAO, VBO_positions, VBO_normals, EBO;
+	// Binding space vertices, one contiguous array per attribute
 	std::vector<glm::vec3> bindingPositions;
 	std::vector<glm::vec3> bindingNormals;
-	std::vector<glm::vec3> shaderPositions;
-	std::vector<glm::vec3> shaderNormals;
+	// SKIN_MAX_INFLUENCES slots per vertex: joint indices into skeleton->joints and weights
+	// summing to 1; unused slots have weight 0
+	std::vector<uint16_t> influenceJoints;
+	std::vector<float> influenceWeights;
+	// Joint -> vertex reverse index: the vertices weighted to joint j are
+	// jointVertices[jointVertexStart[j]] .. jointVertices[jointVertexStart[j + 1] - 1]
+	std::vector<int> jointVertexStart;
+	std::vector<int> jointVertices;
+
+	// shader-related
+	// Vertices are interleaved SkinnedVertex (float position + 10:10:10:2 normal, 16 bytes).
+	// The skinned mesh lives in a ring of SKIN_RING_SEGMENTS copies inside one buffer,
+	// persistently mapped when
+	// GL_ARB_buffer_storage is available, so skinning writes straight into GPU-visible memory.
+	// A segment is only written after the fence of its last draw has passed. Without buffer
+	// storage there is one segment, skinned into staging arrays and copied with glBufferSubData.
+	GLuint VAO, VBO_skinned, EBO;
+	// The bind pose has its own static buffer and VAO, uploaded once
+	GLuint VAO_bindPose, VBO_bindPose;
 	std::vector<unsigned int> shaderIndices;
+	// Levels of detail: LOD k draws shaderIndices[lodIndexStart[k], lodIndexStart[k + 1]) and only uses
+	// the first lodVertexNum[k] vertices (vertices are sorted by the coarsest LOD that keeps them), so
+	// coarser levels skin and upload a prefix of the mesh
+	int lodNum = 1;
+	int lodIndexStart[SKIN_LOD_NUM + 1];
+	int lodVertexNum[SKIN_LOD_NUM];
+	int lod = 0;                 // level the next Update & Draw use
+	int lodOverride = -1;        // forced level, -1 to select by projected size
+	int activeVertexNum = 0;     // lodVertexNum[lod] of the last Update
+	glm::vec3 boundCenter;       // bind pose bounding sphere
+	float boundRadius = 0.0f;
+	// W * inverseB of every joint, rebuilt when the skeleton's pose changes and shared by all vertices
+	std::vector<glm::mat4> palette;
+	// skeleton->generation the palette was built from, the CPU ring was skinned from, and the
+	// palette uniform buffer holds (-1: none yet); an unchanged pose skips all three
+	int paletteGeneration = -1;
+	int ringGeneration = -1;
+	int uploadedGeneration = -1;
+
+	// GPU skinning: the bind pose VBO plus static influences, blended in the vertex shader with the
+	// palette streamed through a uniform buffer each frame; Update then only rebuilds the palette.
+	// The CPU path stays as the reference (see CompareGPUSkinning).
+	bool isGPUSkinning = false;
+	GLuint VAO_gpuSkin, VBO_influences, UBO_palette;
+	// Max difference found by the last CompareGPUSkinning, -1 if it has not run
+	float gpuPositionError = -1.0f;
+	float gpuNormalError = -1.0f;
+
+	// Vertices are skinned in chunks spread over the scheduler's threads (serially if NULL)
+	TaskScheduler* scheduler = NULL;
+	SkinningKernel::Mode kernelMode = SkinningKernel::eAuto;
+	float skinMicroseconds = 0.0f;   // time of the last Update
+	int skinnedVertexNum = 0;        // vertices re-skinned by the last Update
 
+	// Streaming ring
+	bool isPersistentMapped = false;
+	int segmentNum = 1;
+	// Where skinning writes: the mapped buffer, or the staging array; segment s starts at [s * vertexNum]
+	SkinnedVertex* skinnedVertices = NULL;
+	std::vector<SkinnedVertex> stagingVertices;        // only used without persistent mapping
+	GLsync segmentFences[SKIN_RING_SEGMENTS] = {};
+	int segmentFrame[SKIN_RING_SEGMENTS];              // update whose result a segment holds, -1 if none
+	int segmentVertexNum[SKIN_RING_SEGMENTS];          // vertices (a prefix) that result covers
+	int readySegment = -1;                             // latest skinned segment, the one that is drawn
+	int writeSegment = 0;                              // segment Draw has cleared for writing, -1 if none
 
+	// Sparse updates: only vertices of joints that moved since a segment was last written are
+	// re-skinned into it, and (without mapping) only the ranges skinned since the last draw are uploaded
+	int updateFrame = 0;
+	std::vector<glm::mat4> prevPalette;
+	std::vector<int> jointChangedFrame;                // last update each joint's palette entry changed
+	std::vector<char> isVertexDirty;
+	std::vector<std::pair<int, int>> dirtyRanges;      // [begin, end) vertex ranges of this update
+	std::vector<std::pair<int, int>> skinChunks;       // dirtyRanges cut into task-sized pieces
+	std::vector<std::pair<int, int>> pendingUploads;   // skinned but not uploaded yet
 
 	Skin(Skeleton* skel);
 	~Skin();
 
 	void BindBuffer();
 	bool Load(const char* filename = "assets/wasp.skin");
+	// Reorder triangles for vertex cache reuse, then vertices (and their attributes) to first use
+	void OptimizeMesh();
+	// Simplify the mesh into SKIN_LOD_NUM levels and sort the vertices so each level is a prefix
+	void BuildLODs();
+	// Move every per-vertex array to new vertex numbers, remap[old] = new (indices are up to the caller)
+	void RemapVertices(const std::vector<int>& remap);
+	// Pick lod from the projected size of the bounding sphere (see SKIN_LOD_SCREEN_SIZE)
+	void SelectLOD(float screenSize);
+	// Bounding sphere center following the root joint
+	glm::vec3 GetBoundCenter();
 	void Update();
+	// Fill dirtyRanges with the vertices (below activeVertexNum) of joints that changed after update
+	// sinceFrame; everything if sinceFrame is -1
+	void FindDirtyRanges(int sinceFrame);
+	// Skinned vertices of the latest update (vertexNum of them)
+	const SkinnedVertex* GetSkinnedVertices();
+	// The palette has to fit the shader's uniform block
+	bool CanGPUSkin();
+	// Send the palette to UBO_palette and bind it to the shader's JointPalette block
+	void UploadPalette(GLuint shader);
+	// Skin the current pose on the CPU (reference kernel) and in the vertex shader, read back through
+	// transform feedback, and record the max differences; false if they are off or GL failed.
+	// Run with LIBGL_ALWAYS_SOFTWARE=1 to check against Mesa's software rasterizer.
+	bool CompareGPUSkinning(const char* shaderFile = "shaders/shader.glsl");
+	// Farthest bind pose vertex mostly owned by a joint, in that joint's space;
+	// used as the tip of the joint's limb (e.g. a foot for IK)
+	glm::vec3 ComputeJointTip(int joint);
 	void Draw(bool isDrawOriginalSkin, const glm::mat4& viewProjMtx, GLuint shader);
 
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+////////////////////////////////////////
+// SkinningKernel.h
+////////////////////////////////////////
+
+#pragma once
+
+#include "core.h"
+#include <cstdint>
+
+// Linear blend skinning of a vertex range, given a palette of W * inverseB matrices and
+// a fixed number of (joint, weight) influences per vertex. Each vertex blends its palette
+// entries by weight and transforms its position (w = 1) and normal (w = 0) with the result.
+// The output is the compact GPU vertex below: the normal is normalized and packed into
+// GL_INT_2_10_10_10_REV by the kernel itself.
+//
+// Kernels:
+//   eScalar    - plain glm loop, for CPUs without AVX2
+//   eReference - scalar, but with the same multiply / fma sequence as the AVX2 kernel, so
+//                the two agree bit for bit; use it to check the SIMD path
+//   eAVX2      - 8 vertices per iteration with AVX2 gathers and FMA; vertices past the
+//                last multiple of 8 go through eReference
+// eAuto picks eAVX2 when the CPU and OS support it (checked once at runtime), else eScalar.
+
+// 16 bytes: float position + signed normalized 10:10:10:2 normal (w unused)
+struct SkinnedVertex {
+	glm::vec3 position;
+	uint32_t normal;
+};
+
+namespace SkinningKernel {
+	enum Mode { eAuto, eScalar, eReference, eAVX2 };
+
+	// Pack a unit vector as GL_INT_2_10_10_10_REV (components scaled by 511 and rounded)
+	uint32_t PackNormal(const glm::vec3& n);
+	glm::vec3 UnpackNormal(uint32_t packed);
+
+	bool HasAVX2();
+	// The kernel eAuto resolves to on this machine
+	Mode Resolve(Mode mode);
+
+	// influenceNum influences per vertex; joints & weights are indexed [vertex * influenceNum + k].
+	// joints must have one readable spare entry past the last vertex for the AVX2 gathers.
+	void SkinRange(Mode mode, int begin, int end, int influenceNum,
+		const glm::mat4* palette, const uint16_t* joints, const float* weights,
+		const glm::vec3* inPositions, const glm::vec3* inNormals, SkinnedVertex* out);
+}
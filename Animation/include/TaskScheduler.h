@@ -0,0 +1,62 @@
+////////////////////////////////////////
+// TaskScheduler.h
+////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The TaskScheduler runs small jobs on a fixed set of worker threads. Tasks may depend on
+// earlier tasks and are only queued once all their dependencies have finished, so a rig's
+// clip evaluation -> skeleton -> skin chain can be submitted as three linked tasks and many
+// rigs then run side by side. Every thread has its own deque; it pops its newest task and,
+// when empty, steals the oldest task of another thread. Waiting threads (the main thread
+// in Wait, a task inside ParallelFor) run queued tasks instead of blocking, which is what
+// makes nested parallel loops safe.
+
+class TaskScheduler {
+public:
+	struct Task;
+	typedef Task* TaskHandle;
+
+	// workerNum = 0 uses one worker per hardware thread besides the main thread
+	TaskScheduler(int workerNum = 0);
+	~TaskScheduler();
+
+	// Queue fn to run after every task in deps has finished; handles stay valid until Wait returns
+	TaskHandle AddTask(std::function<void()> fn, std::initializer_list<TaskHandle> deps = {});
+	// Run fn(begin, end) over [0, count) in chunks of at most grainSize and return when all are done
+	void ParallelFor(int count, int grainSize, const std::function<void(int, int)>& fn);
+	// Block until every task added so far has finished, helping out meanwhile
+	void Wait();
+	int GetThreadNum() { return queues.size(); }
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task*> tasks;
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<Queue> queues;             // index 0 belongs to threads outside the pool
+	std::deque<Task> taskPool;            // stable storage for this round's tasks, cleared by Wait
+	std::mutex poolMutex;                 // guards taskPool and every task's successor list
+	std::atomic<int> pendingTasks;        // added but not finished
+	std::atomic<int> readyTasks;          // sitting in some queue
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<bool> isQuit;
+
+	void WorkerLoop(int queueIndex);
+	void Push(Task* task);
+	Task* Pop();
+	bool RunOne();
+	void Execute(Task* task);
+};
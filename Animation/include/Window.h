@@ -7,6 +7,7 @@
 #include "Skin.h"
 #include "AnimationPlayer.h"
 #include "AnimRig.h"
+#include "TaskScheduler.h"
 
 class Window {
 public:
@@ -32,6 +33,9 @@ public:
     // Camera
     static Camera* Cam;
 
+    // Runs the per-frame updates of all skeletons & rigs in parallel
+    static TaskScheduler* scheduler;
+
     // Shader Program
     static ShaderProgram* shaderProgram;
 
@@ -55,6 +59,8 @@ public:
 
     // update and draw functions
     static void idleCallback();
+    // Block until the updates started by idleCallback are done; call before touching any rig
+    static void waitForUpdates();
     static void displayCallback(GLFWwindow* window, bool isDrawOriginalSkin, bool isDrawSkel, bool isDrawAttachedSkin, bool isPlayAnim);
 
     // helper to reset the camera
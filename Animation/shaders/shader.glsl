@@ -4,11 +4,22 @@
 
 // Inputs
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+layout (location = 1) in vec3 normal;      // float, or GL_INT_2_10_10_10_REV normalized for skins
+layout (location = 2) in mat4 instanceMtx; // per-instance model matrix, occupies locations 2-5
+layout (location = 6) in ivec4 jointIndices; // GPU skinning: 4 influences per vertex, indices into Palette
+layout (location = 7) in vec4 jointWeights;
 
 // Uniforms
 uniform mat4 ModelMtx = mat4(1);
 uniform mat4 ModelViewProjectionMtx = mat4(1);
+uniform bool IsInstanced = false; // instanced draws apply instanceMtx before ModelMtx
+uniform bool IsSkinned = false;   // GPU skinning: blend Palette by the vertex weights first
+
+// W * inverseB of every joint (std140), streamed once per frame; size matches SKIN_MAX_GPU_JOINTS
+#define MAX_SKIN_JOINTS 256
+layout (std140) uniform JointPalette {
+	mat4 Palette[MAX_SKIN_JOINTS];
+};
 
 // Outputs
 out vec3 fragPosition;
@@ -16,9 +27,20 @@ out vec3 fragNormal;
 
 void main()
 {
-    gl_Position = ModelViewProjectionMtx * vec4(position, 1.0);
-	fragPosition = vec3(ModelMtx * vec4(position, 1));
-	fragNormal = vec3(ModelMtx * vec4(normal, 0));
+	mat4 modelMtx = IsInstanced ? ModelMtx * instanceMtx : ModelMtx;
+	mat4 mvpMtx = IsInstanced ? ModelViewProjectionMtx * instanceMtx : ModelViewProjectionMtx;
+	vec4 localPosition = vec4(position, 1);
+	vec4 localNormal = vec4(normal, 0);
+	if (IsSkinned) {
+		// same blend as the CPU path: weighted sum of the matrices, then one transform
+		mat4 skinMtx = jointWeights.x * Palette[jointIndices.x] + jointWeights.y * Palette[jointIndices.y]
+			+ jointWeights.z * Palette[jointIndices.z] + jointWeights.w * Palette[jointIndices.w];
+		localPosition = skinMtx * localPosition;
+		localNormal = skinMtx * localNormal;
+	}
+    gl_Position = mvpMtx * localPosition;
+	fragPosition = vec3(modelMtx * localPosition);
+	fragNormal = vec3(modelMtx * localNormal);
 }
 
 #endif
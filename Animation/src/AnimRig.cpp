@@ -1,16 +1,20 @@
 #include "AnimRig.h"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 AnimRig::AnimRig()
 {
 	skeleton = new Skeleton();
 	skin = new Skin(skeleton);
+	ik = new IKSolver(skeleton);
 }
 
 AnimRig::~AnimRig()
 {
 	delete skeleton;
 	delete skin;
+	delete ik;
 }
 
 bool AnimRig::Load(const char* skelfile, const char* skinfile)
@@ -31,9 +35,47 @@ bool AnimRig::Load(const char* skelfile, const char* skinfile)
 	}
 }
 
+void AnimRig::SetupFootIK(const char* prefix)
+{
+	skeleton->Update(glm::mat4(1.0f));
+	skeleton->ComputePoseW(glm::mat4(1.0f));
+	for (int i = 0; i < skeleton->joints.size(); i++) {
+		if (strncmp(skeleton->joints[i]->JointName, prefix, strlen(prefix)) == 0) {
+			ik->AddEffector(i, skin->ComputeJointTip(i), 2);
+		}
+	}
+	if (ik->effectors.empty()) return;
+	groundHeight = ik->GetEffectorPosition(0).y;
+	for (int e = 1; e < ik->effectors.size(); e++) {
+		groundHeight = std::min(groundHeight, ik->GetEffectorPosition(e).y);
+	}
+}
+
 void AnimRig::Update(glm::mat4 parentW)
 {
+	UpdateSkeleton(parentW);
+	UpdateSkin();
+}
+
+void AnimRig::UpdateSkeleton(glm::mat4 parentW)
+{
+	if (isFootIK && !ik->effectors.empty()) {
+		// solved on the animated pose's world matrices, so the skeleton is only updated once, with the
+		// result; solving a still pose to the same DOFs leaves it (and its generation) as it is
+		skeleton->ComputePoseW(parentW);
+		// only feet below the ground are solved; the rest keep the animated pose
+		for (int e = 0; e < ik->effectors.size(); e++) {
+			glm::vec3 tip = ik->GetEffectorPosition(e);
+			ik->effectors[e].enabled = tip.y < groundHeight;
+			ik->effectors[e].target = glm::vec3(tip.x, groundHeight, tip.z);
+		}
+		ik->Solve();
+	}
 	skeleton->Update(parentW);
+}
+
+void AnimRig::UpdateSkin()
+{
 	skin->Update();
 }
 
@@ -19,6 +19,19 @@ AnimationPlayer::~AnimationPlayer()
 }
 
 void AnimationPlayer::Update()
+{
+	// a paused or stopped clip keeps its pose (and the skeleton its generation); foot IK edits the
+	// DOFs in place, so with IK on the clip pose is set again every update
+	bool isPoseValid = isEvaluated && curTime == evaluatedTime && !rig->isFootIK;
+	if (!isPoseValid) {
+		isEvaluated = true;
+		evaluatedTime = curTime;
+		EvaluatePose();
+	}
+	AdvanceTime();
+}
+
+void AnimationPlayer::EvaluatePose()
 {
 	// evaluates current poses
 	clip->Evaluate(curTime, poses);
@@ -31,12 +44,12 @@ void AnimationPlayer::Update()
 		poses[0], poses[1], poses[2], 1.0f
 	};
 
-	for (int i = 0; i < rig->skeleton->joints.size(); i++) {
-		rig->skeleton->joints[i]->JointDOF[0]->DOFvalue = poses[3 + i * 3];
-		rig->skeleton->joints[i]->JointDOF[1]->DOFvalue = poses[3 + i * 3 + 1];
-		rig->skeleton->joints[i]->JointDOF[2]->DOFvalue = poses[3 + i * 3 + 2];
-	}
+	// the rest are 3 DOFs per joint, clamped to the joint limits on the way into the skeleton
+	rig->skeleton->SetPose(poses.data() + 3);
+}
 
+void AnimationPlayer::AdvanceTime()
+{
 	// increments current time
 	// set play mode (what to do after end of clip)
 	if (strcmp(playMode, "To infinity!") == 0) 
@@ -14,6 +14,8 @@ void Camera::Update() {
     world[3][2] = Distance;
     world = glm::eulerAngleY(glm::radians(-Azimuth)) * glm::eulerAngleX(glm::radians(-Incline)) * world;
 
+    EyePosition = glm::vec3(world[3]);
+
     // Compute view matrix (inverse of world matrix)
     glm::mat4 view = glm::inverse(world);
 
@@ -23,6 +25,11 @@ void Camera::Update() {
     // Compute final view-projection matrix
     ViewProjectMtx = project * view;
 }
+float Camera::ProjectedSize(const glm::vec3& center, float radius) {
+    float dist = glm::length(center - EyePosition);
+    if (dist <= radius) return 1.0f;
+    return radius / (dist * tanf(glm::radians(FOV) * 0.5f));
+}
 void Camera::Reset() {
     FOV = 45.0f;
     Aspect = 1.33f;
@@ -5,6 +5,7 @@ Cube::Cube() {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO_positions);
     glGenBuffers(1, &VBO_normals);
+    glGenBuffers(1, &VBO_instances);
     glGenBuffers(1, &EBO);
 }
 
@@ -12,6 +13,7 @@ Cube::~Cube() {
     // Delete the VBOs and the VAO.
     glDeleteBuffers(1, &VBO_positions);
     glDeleteBuffers(1, &VBO_normals);
+    glDeleteBuffers(1, &VBO_instances);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
 }
@@ -126,6 +128,17 @@ void Cube::buildCube(glm::vec3 cubeMin, glm::vec3 cubeMax) {
     glEnableVertexAttribArray(normLoc);
     glVertexAttribPointer(normLoc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
 
+    // Bind to the third VBO - We will use it to store one model matrix per instance
+    // A mat4 attribute takes four consecutive locations, one per column, advanced once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_instances);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &modelMtx, GL_STREAM_DRAW);
+    GLuint instLoc = 2;
+    for (GLuint i = 0; i < 4; i++) {
+        glEnableVertexAttribArray(instLoc + i);
+        glVertexAttribPointer(instLoc + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(instLoc + i, 1);
+    }
+
     // Bind the EBO to the bound VAO and send the data
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
@@ -156,6 +169,37 @@ void Cube::drawCube(const glm::mat4& modelMtx, const glm::mat4& viewProjMtx, GLu
     glUseProgram(0);
 }
 
+void Cube::drawCubeInstanced(const std::vector<glm::mat4>& instanceMtx, const glm::mat4& viewProjMtx, GLuint shader) {
+    if (instanceMtx.empty()) return;
+    // Per-instance model matrices are applied in the shader, so the uniforms only carry the view-projection
+    glm::mat4 identityMtx = glm::mat4(1.0f);
+    // actiavte the shader program
+    glUseProgram(shader);
+
+    // get the locations and send the uniforms to the shader
+    glUniformMatrix4fv(glGetUniformLocation(shader, "ModelMtx"), 1, false, (float*)&identityMtx);
+    glUniformMatrix4fv(glGetUniformLocation(shader, "ModelViewProjectionMtx"), 1, GL_FALSE, (float*)&viewProjMtx);
+    glUniform3fv(glGetUniformLocation(shader, "AmbientColor"), 1, &ambientColor[0]);
+    GLint isInstancedLoc = glGetUniformLocation(shader, "IsInstanced");
+    glUniform1i(isInstancedLoc, GL_TRUE);
+
+    // Bind the VAO
+    glBindVertexArray(VAO);
+
+    // Orphan the instance buffer and upload this frame's matrices
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_instances);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * instanceMtx.size(), instanceMtx.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // draw all instances using triangles, indexed with the EBO
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instanceMtx.size());
+
+    // Unbind the VAO and shader program; uniforms persist in the program, so turn instancing back off
+    glBindVertexArray(0);
+    glUniform1i(isInstancedLoc, GL_FALSE);
+    glUseProgram(0);
+}
+
 void Cube::updateCube() {
     // Spin the cube
     spinCube(0.01f);
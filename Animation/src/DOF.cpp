@@ -2,7 +2,8 @@
 #include <iostream>
 
 DOF::DOF() {
-    DOFvalue = 0.0f; // default pose is set to 0.0f
+    localValue = 0.0f; // default pose is set to 0.0f
+    DOFvalue = &localValue;
     DOFmin = -4.0f;
     DOFmax = 4.0f;
 }
@@ -13,11 +14,11 @@ DOF::~DOF()
 
 void DOF::SetValue(float val) {
     if ((DOFmin <= val) && (val <= DOFmax))
-        DOFvalue = val;
+        *DOFvalue = val;
     else if (val < DOFmin)
-        DOFvalue = DOFmin;
+        *DOFvalue = DOFmin;
     else if (DOFmax < val)
-        DOFvalue = DOFmax;
+        *DOFvalue = DOFmax;
 }
 
 void DOF::SetMinMax(float min, float max) {
@@ -26,5 +27,10 @@ void DOF::SetMinMax(float min, float max) {
 }
 
 float DOF::GetValue() {
-    return DOFvalue;
-}
\ No newline at end of file
+    return *DOFvalue;
+}
+
+void DOF::BindStorage(float* storage) {
+    *storage = *DOFvalue;
+    DOFvalue = storage;
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////
+// FastMath.cpp
+////////////////////////////////////////
+
+#include "FastMath.h"
+#include <emmintrin.h>
+
+namespace {
+	// Cephes single precision sin/cos: reduce to [-pi/4, pi/4] in octants, then a
+	// degree 7 polynomial for sin and degree 8 for cos on the reduced argument.
+	const float FOPI = 1.27323954473516f; // 4 / pi
+	const float DP1 = -0.78515625f;        // pi/4 split in three parts
+	const float DP2 = -2.4187564849853515625e-4f;
+	const float DP3 = -3.77489497744594108e-8f;
+	const float SINCOF_P0 = -1.9515295891e-4f;
+	const float SINCOF_P1 = 8.3321608736e-3f;
+	const float SINCOF_P2 = -1.6666654611e-1f;
+	const float COSCOF_P0 = 2.443315711809948e-5f;
+	const float COSCOF_P1 = -1.388731625493765e-3f;
+	const float COSCOF_P2 = 4.166664568298827e-2f;
+
+	inline void SinCos4(__m128 x, __m128* s, __m128* c)
+	{
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+		__m128 signSin = _mm_and_ps(x, signMask);
+		x = _mm_andnot_ps(signMask, x); // |x|
+
+		// octant index j, rounded up to even so the reduced argument stays in [-pi/4, pi/4]
+		__m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOPI)));
+		j = _mm_add_epi32(j, _mm_set1_epi32(1));
+		j = _mm_and_si128(j, _mm_set1_epi32(~1));
+		__m128 y = _mm_cvtepi32_ps(j);
+
+		// octants 4-7 flip the sign of sin, octants 2-5 flip the sign of cos
+		__m128 swapSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+		__m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+		// octants 2,3,6,7 swap the two polynomials
+		__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+		signSin = _mm_xor_ps(signSin, swapSin);
+
+		// extended precision x - j * pi/4
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+		__m128 z = _mm_mul_ps(x, x);
+
+		__m128 yc = _mm_set1_ps(COSCOF_P0);
+		yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(COSCOF_P1));
+		yc = _mm_add_ps(_mm_mul_ps(yc, z), _mm_set1_ps(COSCOF_P2));
+		yc = _mm_mul_ps(_mm_mul_ps(yc, z), z);
+		yc = _mm_sub_ps(yc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+		yc = _mm_add_ps(yc, _mm_set1_ps(1.0f));
+
+		__m128 ys = _mm_set1_ps(SINCOF_P0);
+		ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(SINCOF_P1));
+		ys = _mm_add_ps(_mm_mul_ps(ys, z), _mm_set1_ps(SINCOF_P2));
+		ys = _mm_mul_ps(_mm_mul_ps(ys, z), x);
+		ys = _mm_add_ps(ys, x);
+
+		__m128 sinPoly = _mm_or_ps(_mm_and_ps(polyMask, ys), _mm_andnot_ps(polyMask, yc));
+		__m128 cosPoly = _mm_or_ps(_mm_and_ps(polyMask, yc), _mm_andnot_ps(polyMask, ys));
+		*s = _mm_xor_ps(sinPoly, signSin);
+		*c = _mm_xor_ps(cosPoly, signCos);
+	}
+}
+
+void FastMath::SinCos(const float* x, float* s, float* c, int n)
+{
+	__m128 s4, c4;
+	int i = 0;
+	for (; i + 4 <= n; i += 4) {
+		SinCos4(_mm_loadu_ps(x + i), &s4, &c4);
+		_mm_storeu_ps(s + i, s4);
+		_mm_storeu_ps(c + i, c4);
+	}
+	if (i < n) {
+		// pad the tail into one more vector so it goes through the same code path
+		float xt[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, st[4], ct[4];
+		for (int k = 0; i + k < n; k++) xt[k] = x[i + k];
+		SinCos4(_mm_loadu_ps(xt), &s4, &c4);
+		_mm_storeu_ps(st, s4);
+		_mm_storeu_ps(ct, c4);
+		for (int k = 0; i + k < n; k++) {
+			s[i + k] = st[k];
+			c[i + k] = ct[k];
+		}
+	}
+}
+
+void FastMath::Distance(const glm::vec3* a, const glm::vec3* b, float* d, int n)
+{
+	const float* pa = &a[0].x;
+	const float* pb = &b[0].x;
+	int i = 0;
+	for (; i + 4 <= n; i += 4, pa += 12, pb += 12) {
+		// e = a - b over 4 interleaved vec3: e0 = x0 y0 z0 x1, e1 = y1 z1 x2 y2, e2 = z2 x3 y3 z3
+		__m128 e0 = _mm_sub_ps(_mm_loadu_ps(pa), _mm_loadu_ps(pb));
+		__m128 e1 = _mm_sub_ps(_mm_loadu_ps(pa + 4), _mm_loadu_ps(pb + 4));
+		__m128 e2 = _mm_sub_ps(_mm_loadu_ps(pa + 8), _mm_loadu_ps(pb + 8));
+		// transpose to x0..x3, y0..y3, z0..z3
+		__m128 t0 = _mm_shuffle_ps(e1, e2, _MM_SHUFFLE(2, 1, 3, 2));
+		__m128 t1 = _mm_shuffle_ps(e0, e1, _MM_SHUFFLE(1, 0, 2, 1));
+		__m128 x = _mm_shuffle_ps(e0, t0, _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+		__m128 z = _mm_shuffle_ps(t1, e2, _MM_SHUFFLE(3, 0, 3, 1));
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		_mm_storeu_ps(d + i, _mm_sqrt_ps(len2));
+	}
+	for (; i < n; i++) {
+		glm::vec3 e = a[i] - b[i];
+		d[i] = _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(e.x * e.x + e.y * e.y + e.z * e.z)));
+	}
+}
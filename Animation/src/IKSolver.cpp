@@ -0,0 +1,382 @@
+////////////////////////////////////////
+// IKSolver.cpp
+////////////////////////////////////////
+
+#include "IKSolver.h"
+#include "FastMath.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	const int FABRIK_PASSES = 10;
+	// stop DLS and fall back once the error improves by less than this fraction for a few iterations
+	const float STALL_RATIO = 0.99f;
+	const int STALL_ITERATIONS = 3;
+
+	// Solve A * x = b in place for a symmetric positive definite n x n matrix (Cholesky)
+	void CholeskySolve(float* A, float* b, int n)
+	{
+		for (int j = 0; j < n; j++) {
+			float d = A[j * n + j];
+			for (int k = 0; k < j; k++) d -= A[j * n + k] * A[j * n + k];
+			d = sqrtf(std::max(d, 1e-12f));
+			A[j * n + j] = d;
+			for (int i = j + 1; i < n; i++) {
+				float s = A[i * n + j];
+				for (int k = 0; k < j; k++) s -= A[i * n + k] * A[j * n + k];
+				A[i * n + j] = s / d;
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			float s = b[i];
+			for (int k = 0; k < i; k++) s -= A[i * n + k] * b[k];
+			b[i] = s / A[i * n + i];
+		}
+		for (int i = n - 1; i >= 0; i--) {
+			float s = b[i];
+			for (int k = i + 1; k < n; k++) s -= A[k * n + i] * b[k];
+			b[i] = s / A[i * n + i];
+		}
+	}
+
+	// Euler angles (x, y, z) of a rotation R = Rz * Ry * Rx, the joint rotation order
+	glm::vec3 ExtractEulerXYZ(const glm::mat3& R)
+	{
+		float y = asinf(glm::clamp(-R[0][2], -1.0f, 1.0f));
+		float x = atan2f(R[1][2], R[2][2]);
+		float z = atan2f(R[0][1], R[0][0]);
+		return glm::vec3(x, y, z);
+	}
+
+	// Smallest rotation taking direction a onto direction b
+	// v / |v|, else the direction of fallback, else zero: coincident points have no direction
+	glm::vec3 DirectionOr(glm::vec3 v, glm::vec3 fallback)
+	{
+		float length = glm::length(v);
+		if (length > 0.0f) return v / length;
+		length = glm::length(fallback);
+		return length > 0.0f ? fallback / length : glm::vec3(0.0f);
+	}
+
+	glm::mat3 RotationBetween(glm::vec3 a, glm::vec3 b)
+	{
+		if (glm::length(a) == 0.0f || glm::length(b) == 0.0f) return glm::mat3(1.0f); // no direction to turn
+		a = glm::normalize(a);
+		b = glm::normalize(b);
+		glm::vec3 axis = glm::cross(a, b);
+		float sinAngle = glm::length(axis);
+		if (sinAngle < 1e-6f) return glm::mat3(1.0f);
+		float angle = atan2f(sinAngle, glm::dot(a, b));
+		return glm::mat3(glm::rotate(angle, axis / sinAngle));
+	}
+}
+
+IKSolver::IKSolver(Skeleton* skel)
+{
+	skeleton = skel;
+	isChainBuilt = false;
+	stats = { 0, 0.0f, 0.0f, false };
+}
+
+IKSolver::~IKSolver()
+{
+}
+
+int IKSolver::AddEffector(int joint, glm::vec3 localOffset, int chainLength)
+{
+	effectors.push_back({ joint, localOffset, glm::vec3(0.0f), chainLength, false });
+	isChainBuilt = false;
+	return effectors.size() - 1;
+}
+
+glm::vec3 IKSolver::GetEffectorPosition(int effector)
+{
+	const IKEffector& eff = effectors[effector];
+	return glm::vec3(skeleton->poseW[eff.joint] * glm::vec4(eff.localOffset, 1.0f));
+}
+
+void IKSolver::BuildChains()
+{
+	// collect the joints of every chain, then sort them so parents are updated first
+	std::vector<int> jointSlot(skeleton->joints.size(), -1);
+	slotJoint.clear();
+	for (auto& eff : effectors) {
+		Joint* jnt = skeleton->joints[eff.joint];
+		for (int k = 0; k < eff.chainLength && jnt; k++, jnt = jnt->parent) {
+			int idx = std::find(skeleton->joints.begin(), skeleton->joints.end(), jnt) - skeleton->joints.begin();
+			if (jointSlot[idx] < 0) {
+				jointSlot[idx] = 0;
+				slotJoint.push_back(idx);
+			}
+		}
+	}
+	std::sort(slotJoint.begin(), slotJoint.end());
+	int slotNum = slotJoint.size();
+	for (int s = 0; s < slotNum; s++) jointSlot[slotJoint[s]] = s;
+
+	slotParent.assign(slotNum, -1);
+	slotOffset.resize(slotNum);
+	slotBaseW.resize(slotNum);
+	slotW.resize(slotNum);
+	theta.resize(3 * slotNum);
+	thetaMin.resize(3 * slotNum);
+	thetaMax.resize(3 * slotNum);
+	sines.resize(3 * slotNum);
+	cosines.resize(3 * slotNum);
+	pose.resize(3 * slotNum);
+	prevTheta.resize(3 * slotNum);
+	prevPose.resize(3 * slotNum);
+	prevValid.assign(slotNum, 0);
+	for (int s = 0; s < slotNum; s++) {
+		Joint* jnt = skeleton->joints[slotJoint[s]];
+		slotOffset[s] = jnt->offset;
+		if (jnt->parent) {
+			int parentIdx = std::find(skeleton->joints.begin(), skeleton->joints.end(), jnt->parent) - skeleton->joints.begin();
+			slotParent[s] = jointSlot[parentIdx];
+		}
+		for (int k = 0; k < 3; k++) {
+			thetaMin[3 * s + k] = skeleton->DOFmins[3 * slotJoint[s] + k];
+			thetaMax[3 * s + k] = skeleton->DOFmaxs[3 * slotJoint[s] + k];
+		}
+	}
+
+	chainSlots.assign(effectors.size(), std::vector<int>());
+	for (int e = 0; e < effectors.size(); e++) {
+		Joint* jnt = skeleton->joints[effectors[e].joint];
+		for (int k = 0; k < effectors[e].chainLength && jnt; k++, jnt = jnt->parent) {
+			int idx = std::find(skeleton->joints.begin(), skeleton->joints.end(), jnt) - skeleton->joints.begin();
+			chainSlots[e].insert(chainSlots[e].begin(), jointSlot[idx]);
+		}
+	}
+	isChainBuilt = true;
+}
+
+void IKSolver::ForwardKinematics(int firstSlot)
+{
+	int slotNum = slotJoint.size();
+	int first = 3 * firstSlot;
+	FastMath::SinCos(theta.data() + first, sines.data() + first, cosines.data() + first, 3 * slotNum - first);
+	for (int s = firstSlot; s < slotNum; s++) {
+		const glm::mat4& parentW = slotParent[s] >= 0 ? slotW[slotParent[s]] : slotBaseW[s];
+		slotW[s] = parentW * Joint::ComputeLocal(slotOffset[s], &sines[3 * s], &cosines[3 * s]);
+	}
+}
+
+glm::vec3 IKSolver::EffectorWorld(int effector)
+{
+	int s = chainSlots[effector].back();
+	return glm::vec3(slotW[s] * glm::vec4(effectors[effector].localOffset, 1.0f));
+}
+
+float IKSolver::ComputeError(const std::vector<int>& active, float* err)
+{
+	// err gets the clamped correction for each active effector; returns the largest distance
+	int activeNum = active.size();
+	effectorPos.resize(activeNum);
+	effectorTarget.resize(activeNum);
+	effectorDist.resize(activeNum);
+	for (int a = 0; a < activeNum; a++) {
+		effectorPos[a] = EffectorWorld(active[a]);
+		effectorTarget[a] = effectors[active[a]].target;
+	}
+	FastMath::Distance(effectorTarget.data(), effectorPos.data(), effectorDist.data(), activeNum);
+	float maxDist = 0.0f;
+	for (int a = 0; a < activeNum; a++) {
+		glm::vec3 e = effectorTarget[a] - effectorPos[a];
+		float dist = effectorDist[a];
+		maxDist = std::max(maxDist, dist);
+		if (dist > maxStep) e *= maxStep / dist;
+		err[3 * a] = e.x;
+		err[3 * a + 1] = e.y;
+		err[3 * a + 2] = e.z;
+	}
+	return maxDist;
+}
+
+void IKSolver::DampedLeastSquaresStep(const std::vector<int>& active, const float* err)
+{
+	int rows = 3 * active.size();
+	int cols = theta.size();
+	J.assign(rows * cols, 0.0f);
+
+	// column of DOF k in slot s for effector e: world rotation axis x (effector - joint pivot)
+	for (int a = 0; a < active.size(); a++) {
+		glm::vec3 effPos = EffectorWorld(active[a]);
+		for (int s : chainSlots[active[a]]) {
+			const glm::mat4& parentW = slotParent[s] >= 0 ? slotW[slotParent[s]] : slotBaseW[s];
+			glm::mat3 M = glm::mat3(parentW);
+			float sz = sines[3 * s + 2], cz = cosines[3 * s + 2];
+			glm::vec3 axisZ = M[2];
+			glm::vec3 axisY = M * glm::vec3(-sz, cz, 0.0f); // Rz * (0, 1, 0)
+			glm::vec3 axisX = glm::vec3(slotW[s][0]);       // Rx leaves x alone
+			glm::vec3 r = effPos - glm::vec3(slotW[s][3]);
+			glm::vec3 axes[3] = { axisX, axisY, axisZ };
+			for (int k = 0; k < 3; k++) {
+				glm::vec3 col = glm::cross(axes[k], r);
+				J[(3 * a) * cols + 3 * s + k] = col.x;
+				J[(3 * a + 1) * cols + 3 * s + k] = col.y;
+				J[(3 * a + 2) * cols + 3 * s + k] = col.z;
+			}
+		}
+	}
+
+	// a DOF sitting on a limit that the error pushes further out is frozen for this step
+	for (int c = 0; c < cols; c++) {
+		float g = 0.0f;
+		for (int r = 0; r < rows; r++) g += J[r * cols + c] * err[r];
+		bool atMin = theta[c] <= thetaMin[c] && g < 0.0f;
+		bool atMax = theta[c] >= thetaMax[c] && g > 0.0f;
+		if (atMin || atMax) {
+			for (int r = 0; r < rows; r++) J[r * cols + c] = 0.0f;
+		}
+	}
+
+	// delta = J^T * (J * J^T + lambda^2 * I)^-1 * err
+	A.assign(rows * rows, 0.0f);
+	for (int i = 0; i < rows; i++) {
+		for (int j = 0; j <= i; j++) {
+			float sum = 0.0f;
+			for (int c = 0; c < cols; c++) sum += J[i * cols + c] * J[j * cols + c];
+			A[i * rows + j] = sum;
+			A[j * rows + i] = sum;
+		}
+		A[i * rows + i] += damping * damping;
+	}
+	rhs.assign(err, err + rows);
+	CholeskySolve(A.data(), rhs.data(), rows);
+	for (int c = 0; c < cols; c++) {
+		float d = 0.0f;
+		for (int r = 0; r < rows; r++) d += J[r * cols + c] * rhs[r];
+		theta[c] = glm::clamp(theta[c] + d, thetaMin[c], thetaMax[c]);
+	}
+}
+
+void IKSolver::FabrikChain(int effector)
+{
+	// positions: chain joint pivots from the chain root down, then the effector point
+	const std::vector<int>& chain = chainSlots[effector];
+	int pointNum = chain.size() + 1;
+	std::vector<glm::vec3> p(pointNum);
+	std::vector<float> len(pointNum - 1);
+	for (int i = 0; i < chain.size(); i++) p[i] = glm::vec3(slotW[chain[i]][3]);
+	p[pointNum - 1] = EffectorWorld(effector);
+	FastMath::Distance(p.data() + 1, p.data(), len.data(), pointNum - 1);
+	float reach = 0.0f;
+	for (int i = 0; i < pointNum - 1; i++) reach += len[i];
+
+	glm::vec3 target = effectors[effector].target;
+	glm::vec3 base = p[0];
+	std::vector<glm::vec3> q = p;
+	if (glm::length(target - base) >= reach) {
+		// out of reach: stretch straight toward the target
+		glm::vec3 dir = DirectionOr(target - base, p[pointNum - 1] - base);
+		for (int i = 1; i < pointNum; i++) q[i] = q[i - 1] + dir * len[i - 1];
+	}
+	else {
+		for (int pass = 0; pass < FABRIK_PASSES; pass++) {
+			// backward from the target, then forward from the fixed base
+			q[pointNum - 1] = target;
+			for (int i = pointNum - 2; i >= 0; i--) q[i] = q[i + 1] + DirectionOr(q[i] - q[i + 1], p[i] - p[i + 1]) * len[i];
+			q[0] = base;
+			for (int i = 1; i < pointNum; i++) q[i] = q[i - 1] + DirectionOr(q[i] - q[i - 1], p[i] - p[i - 1]) * len[i - 1];
+			if (glm::length(q[pointNum - 1] - target) < tolerance) break;
+		}
+	}
+
+	// turn each joint so its next point lies along the FABRIK direction, then re-read angles
+	for (int i = 0; i < chain.size(); i++) {
+		int s = chain[i];
+		glm::vec3 pivot = glm::vec3(slotW[s][3]);
+		glm::vec3 next = i + 1 < chain.size() ? glm::vec3(slotW[chain[i + 1]][3]) : EffectorWorld(effector);
+		glm::mat3 worldRot = RotationBetween(next - pivot, q[i + 1] - q[i]) * glm::mat3(slotW[s]);
+		const glm::mat4& parentW = slotParent[s] >= 0 ? slotW[slotParent[s]] : slotBaseW[s];
+		glm::vec3 angles = ExtractEulerXYZ(glm::transpose(glm::mat3(parentW)) * worldRot);
+		for (int k = 0; k < 3; k++) {
+			theta[3 * s + k] = glm::clamp(angles[k], thetaMin[3 * s + k], thetaMax[3 * s + k]);
+		}
+		ForwardKinematics(s);
+	}
+}
+
+void IKSolver::Solve()
+{
+	auto startTime = std::chrono::steady_clock::now();
+	stats = { 0, 0.0f, 0.0f, false };
+	if (!isChainBuilt) BuildChains();
+
+	std::vector<int> active;
+	for (int e = 0; e < effectors.size(); e++) {
+		if (effectors[e].enabled) active.push_back(e);
+	}
+	std::vector<char> slotActive(slotJoint.size(), 0);
+	for (int e : active) {
+		for (int s : chainSlots[e]) slotActive[s] = 1;
+	}
+
+	// gather chain DOFs; where the slot was solved last frame too, warm-start from this frame's
+	// pose plus last frame's IK correction, so the chain still follows the animation
+	for (int s = 0; s < slotJoint.size(); s++) {
+		int parent = skeleton->jointParent[slotJoint[s]];
+		slotBaseW[s] = parent >= 0 ? skeleton->poseW[parent] : skeleton->poseParentW;
+		bool isWarm = warmStart && slotActive[s] && prevValid[s];
+		for (int k = 0; k < 3; k++) {
+			int i = 3 * s + k;
+			pose[i] = skeleton->DOFvalues[3 * slotJoint[s] + k];
+			if (!isWarm) theta[i] = pose[i];
+			else if (pose[i] == prevPose[i]) theta[i] = prevTheta[i]; // exactly last frame's solution for the same pose
+			else theta[i] = glm::clamp(pose[i] + (prevTheta[i] - prevPose[i]), thetaMin[i], thetaMax[i]);
+		}
+	}
+	if (active.empty()) {
+		std::fill(prevValid.begin(), prevValid.end(), 0);
+		return;
+	}
+	ForwardKinematics();
+
+	std::vector<float> err(3 * active.size());
+	float error = ComputeError(active, err.data());
+	float bestError = error;
+	int stallCount = 0;
+	auto elapsed = [&]() {
+		return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+	};
+	while (error > tolerance && stats.iterations < maxIterations && elapsed() < budgetMicroseconds) {
+		DampedLeastSquaresStep(active, err.data());
+		ForwardKinematics();
+		stats.iterations++;
+		error = ComputeError(active, err.data());
+		stallCount = error < bestError * STALL_RATIO ? 0 : stallCount + 1;
+		bestError = std::min(bestError, error);
+		if (stallCount >= STALL_ITERATIONS) break;
+	}
+	if (useFallback && error > tolerance && elapsed() < budgetMicroseconds) {
+		// DLS stalled (singular pose, target out of reach, or fighting a limit); FABRIK clamps to the
+		// limits after choosing its directions, so it only stays if it ends up closer
+		stalledTheta = theta;
+		for (int e : active) {
+			if (glm::length(effectors[e].target - EffectorWorld(e)) > tolerance) FabrikChain(e);
+		}
+		float fallbackError = ComputeError(active, err.data());
+		if (fallbackError <= error) {
+			stats.usedFallback = true;
+			error = fallbackError;
+		}
+		else {
+			theta = stalledTheta;
+			ForwardKinematics();
+		}
+	}
+
+	// write the solved chains back to the skeleton and remember them for next frame
+	for (int s = 0; s < slotJoint.size(); s++) {
+		prevValid[s] = slotActive[s];
+		if (!slotActive[s]) continue;
+		for (int k = 0; k < 3; k++) {
+			skeleton->DOFvalues[3 * slotJoint[s] + k] = theta[3 * s + k];
+			prevTheta[3 * s + k] = theta[3 * s + k];
+			prevPose[3 * s + k] = pose[3 * s + k];
+		}
+	}
+	stats.error = error;
+	stats.microseconds = elapsed();
+}
@@ -1,5 +1,4 @@
 #include "Joint.h"
-#include "Cube.h"
 #include "cmath"
 #include <iostream>
 
@@ -10,13 +9,14 @@ Joint::Joint()
 	boxmax = { 0.1f, 0.1f, 0.1f };
 	L = glm::mat4(1.0f);
 	W = glm::mat4(1.0f);
+	boxMtx = glm::mat4(1.0f);
+	parent = NULL;
 	DOF* DOFx = new DOF();
 	DOF* DOFy = new DOF();
 	DOF* DOFz = new DOF();
 	JointDOF.push_back(DOFx);
 	JointDOF.push_back(DOFy);
 	JointDOF.push_back(DOFz);
-	cube = new Cube();
 	strcpy_s(JointName, "");
 }
 
@@ -90,7 +90,8 @@ bool Joint::Load(Tokenizer* tknizer)
 		}
 		else if (strcmp(temp, "}") == 0)
 		{
-			cube->buildCube(boxmin, boxmax);
+			// the box is drawn as an instance of the skeleton's unit cube centered at the origin
+			boxMtx = glm::translate(0.5f * (boxmin + boxmax)) * glm::scale(boxmax - boxmin);
 			return true;
 		}
 		else
@@ -111,27 +112,27 @@ void Joint::ResetAll()
 	}
 }
 
-void Joint::Update(glm::mat4 parentW)
+glm::mat4 Joint::ComputeLocal(const glm::vec3& offset, const float* sines, const float* cosines)
 {
-	float thetaX = JointDOF[0]->GetValue();
-	float thetaY = JointDOF[1]->GetValue();
-	float thetaZ = JointDOF[2]->GetValue();
+	float sinX = sines[0], cosX = cosines[0];
+	float sinY = sines[1], cosY = cosines[1];
+	float sinZ = sines[2], cosZ = cosines[2];
 
 	glm::mat4 Rx = glm::mat4(
 		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
-		glm::vec4(0.0f, cos(thetaX), sin(thetaX), 0.0f),
-		glm::vec4(0.0f, -sin(thetaX), cos(thetaX), 0.0f),
+		glm::vec4(0.0f, cosX, sinX, 0.0f),
+		glm::vec4(0.0f, -sinX, cosX, 0.0f),
 		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
 	);
 	glm::mat4 Ry = glm::mat4(
-		glm::vec4(cos(thetaY), 0.0f, -sin(thetaY), 0.0f),
+		glm::vec4(cosY, 0.0f, -sinY, 0.0f),
 		glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),
-		glm::vec4(sin(thetaY), 0.0f, cos(thetaY), 0.0f),
+		glm::vec4(sinY, 0.0f, cosY, 0.0f),
 		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
 	);
 	glm::mat4 Rz = glm::mat4(
-		glm::vec4(cos(thetaZ), sin(thetaZ), 0.0f, 0.0f),
-		glm::vec4(-sin(thetaZ), cos(thetaZ), 0.0f, 0.0f),
+		glm::vec4(cosZ, sinZ, 0.0f, 0.0f),
+		glm::vec4(-sinZ, cosZ, 0.0f, 0.0f),
 		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
 		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
 	);
@@ -142,25 +143,19 @@ void Joint::Update(glm::mat4 parentW)
 		glm::vec4(offset, 1.0f)
 	);
 
-	L = T * Rz * Ry * Rx;
-	W = parentW * L;
-
-	for (int i = 0; i < children.size(); i++) {
-		children[i]->Update(W);
-	}
+	return T * Rz * Ry * Rx;
 }
 
-void Joint::AddChild(Joint* newChild)
+void Joint::Update(const glm::mat4& parentW, const float* sines, const float* cosines)
 {
-	children.push_back(newChild);
+	L = ComputeLocal(offset, sines, cosines);
+	W = parentW * L;
 }
 
-void Joint::Draw(const glm::mat4& viewProjMtx, GLuint shader)
+void Joint::AddChild(Joint* newChild)
 {
-	cube->drawCube(W, viewProjMtx, shader);
-	for (int i = 0; i < children.size(); i++) {
-		children[i]->Draw(viewProjMtx, shader);
-	}
+	newChild->parent = this;
+	children.push_back(newChild);
 }
 
 void Joint::BuildJointVector(std::vector<Joint*>* joints_ref)
@@ -0,0 +1,310 @@
+////////////////////////////////////////
+// MeshOptimizer.cpp
+////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <map>
+#include <queue>
+
+float MeshOptimizer::ComputeACMR(const std::vector<unsigned int>& indices, int vertexNum, int cacheSize)
+{
+	int triangleNum = indices.size() / 3;
+	if (triangleNum == 0) return 0.0f;
+	// time each vertex entered the FIFO; it is still cached while fewer than cacheSize misses followed
+	std::vector<int> cachedAt(vertexNum, -cacheSize - 1);
+	int missNum = 0;
+	for (unsigned int v : indices) {
+		if (missNum - cachedAt[v] > cacheSize) {
+			cachedAt[v] = missNum;
+			missNum++;
+		}
+	}
+	return (float)missNum / triangleNum;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, int vertexNum, int cacheSize)
+{
+	int triangleNum = indices.size() / 3;
+	if (triangleNum == 0) return;
+
+	// vertex -> triangle adjacency; live counts the triangles of a vertex not emitted yet
+	std::vector<int> adjacencyStart(vertexNum + 1, 0);
+	for (unsigned int v : indices) adjacencyStart[v + 1]++;
+	for (int v = 0; v < vertexNum; v++) adjacencyStart[v + 1] += adjacencyStart[v];
+	std::vector<int> adjacency(indices.size());
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (int i = 0; i < indices.size(); i++) adjacency[fill[indices[i]]++] = i / 3;
+	std::vector<int> live(vertexNum);
+	for (int v = 0; v < vertexNum; v++) live[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+
+	std::vector<int> cacheTime(vertexNum, 0);
+	std::vector<char> isEmitted(triangleNum, 0);
+	std::vector<int> deadEnd;      // recently used vertices, to restart from when a fan runs dry
+	std::vector<int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	int time = cacheSize + 1;
+	int cursor = 0;                // scan position for a fresh start once the dead-end stack is empty
+
+	auto nextStart = [&]() {
+		while (!deadEnd.empty()) {
+			int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) return v;
+		}
+		for (; cursor < vertexNum; cursor++) {
+			if (live[cursor] > 0) return cursor;
+		}
+		return -1;
+	};
+
+	int fan = nextStart();
+	while (fan >= 0) {
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (int a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+			int t = adjacency[a];
+			if (isEmitted[t]) continue;
+			isEmitted[t] = 1;
+			for (int c = 0; c < 3; c++) {
+				int v = indices[3 * t + c];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+			}
+		}
+
+		// next fan: the candidate that stays in cache for its remaining triangles and entered it
+		// earliest, so its entries are used before they get evicted
+		int best = -1;
+		int bestPriority = -1;
+		for (int v : candidates) {
+			if (live[v] == 0) continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize) priority = time - cacheTime[v];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = v;
+			}
+		}
+		fan = best >= 0 ? best : nextStart();
+	}
+	indices.swap(output);
+}
+
+std::vector<int> MeshOptimizer::OptimizeVertexFetch(std::vector<unsigned int>& indices, int vertexNum)
+{
+	std::vector<int> remap(vertexNum, -1);
+	int next = 0;
+	for (unsigned int& v : indices) {
+		if (remap[v] < 0) remap[v] = next++;
+		v = remap[v];
+	}
+	for (int v = 0; v < vertexNum; v++) {
+		if (remap[v] < 0) remap[v] = next++;
+	}
+	return remap;
+}
+
+namespace {
+	// Symmetric 4x4 error quadric: Q(p) = p^T A p + 2 b.p + c, in double to keep small errors exact
+	struct Quadric {
+		double a00, a01, a02, a11, a12, a22, b0, b1, b2, c;
+
+		// weight * squared distance to the plane n.p + d = 0
+		static Quadric Plane(const glm::dvec3& n, double d, double weight) {
+			return { weight * n.x * n.x, weight * n.x * n.y, weight * n.x * n.z, weight * n.y * n.y,
+				weight * n.y * n.z, weight * n.z * n.z, weight * n.x * d, weight * n.y * d, weight * n.z * d, weight * d * d };
+		}
+		void operator+=(const Quadric& q) {
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+		}
+		double Error(const glm::dvec3& p) const {
+			double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+				+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+				+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+			return std::max(e, 0.0);
+		}
+	};
+
+	struct Collapse {
+		double cost;
+		int from, to;
+		int fromVersion, toVersion;
+		bool operator<(const Collapse& other) const { return cost > other.cost; } // min-heap
+	};
+
+	// Open borders get a plane through the edge, perpendicular to its triangle, this much stronger
+	const double BORDER_WEIGHT = 10.0;
+	// Collapses may tilt a triangle's normal up to about 78 degrees
+	const double MIN_NORMAL_DOT = 0.2;
+}
+
+void MeshOptimizer::SimplifyLODs(const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+	const std::vector<float>& triangleRatios, const std::function<float(int, int)>& attributeCost,
+	std::vector<std::vector<unsigned int>>& lodIndices, std::vector<int>& vertexLOD)
+{
+	int vertexNum = positions.size();
+	int triangleNum = indices.size() / 3;
+	std::vector<int> tris(indices.begin(), indices.end());
+	std::vector<char> isTriangleAlive(triangleNum, 1);
+	std::vector<std::vector<int>> vertexTriangles(vertexNum);
+	for (int t = 0; t < triangleNum; t++) {
+		for (int c = 0; c < 3; c++) vertexTriangles[tris[3 * t + c]].push_back(t);
+	}
+	auto pos = [&](int v) { return glm::dvec3(positions[v]); };
+	auto triangleNormal = [&](int t) { // not normalized; length is twice the area
+		return glm::cross(pos(tris[3 * t + 1]) - pos(tris[3 * t]), pos(tris[3 * t + 2]) - pos(tris[3 * t]));
+	};
+
+	// area-weighted plane quadrics, plus border planes
+	std::vector<Quadric> quadrics(vertexNum, Quadric{});
+	std::map<std::pair<int, int>, int> edgeUse;
+	double totalArea = 0.0;
+	for (int t = 0; t < triangleNum; t++) {
+		glm::dvec3 n = triangleNormal(t);
+		double area = 0.5 * glm::length(n);
+		if (area <= 0.0) continue;
+		totalArea += area;
+		n = glm::normalize(n);
+		Quadric q = Quadric::Plane(n, -glm::dot(n, pos(tris[3 * t])), area);
+		for (int c = 0; c < 3; c++) {
+			quadrics[tris[3 * t + c]] += q;
+			int a = tris[3 * t + c], b = tris[3 * t + (c + 1) % 3];
+			edgeUse[{ std::min(a, b), std::max(a, b) }]++;
+		}
+	}
+	double edgeScale = triangleNum > 0 ? totalArea / triangleNum : 0.0;
+	for (int t = 0; t < triangleNum; t++) {
+		glm::dvec3 n = triangleNormal(t);
+		if (glm::length(n) <= 0.0) continue;
+		n = glm::normalize(n);
+		for (int c = 0; c < 3; c++) {
+			int a = tris[3 * t + c], b = tris[3 * t + (c + 1) % 3];
+			if (edgeUse[{ std::min(a, b), std::max(a, b) }] != 1) continue;
+			glm::dvec3 edge = pos(b) - pos(a);
+			double lengthSq = glm::dot(edge, edge);
+			if (lengthSq <= 0.0) continue;
+			glm::dvec3 borderNormal = glm::normalize(glm::cross(edge, n));
+			Quadric q = Quadric::Plane(borderNormal, -glm::dot(borderNormal, pos(a)), BORDER_WEIGHT * lengthSq);
+			quadrics[a] += q;
+			quadrics[b] += q;
+		}
+	}
+
+	// live neighbours of a vertex
+	auto neighbours = [&](int v, std::vector<int>& out) {
+		out.clear();
+		for (int t : vertexTriangles[v]) {
+			if (!isTriangleAlive[t]) continue;
+			for (int c = 0; c < 3; c++) {
+				int n = tris[3 * t + c];
+				if (n != v && std::find(out.begin(), out.end(), n) == out.end()) out.push_back(n);
+			}
+		}
+	};
+
+	// candidate collapses in a heap, invalidated lazily by bumping the version of a changed vertex
+	std::vector<int> version(vertexNum, 0);
+	std::vector<char> isRemoved(vertexNum, 0);
+	std::priority_queue<Collapse> heap;
+	std::vector<int> around, aroundTo;
+	auto pushCollapses = [&](int v) {
+		neighbours(v, around);
+		for (int n : around) {
+			for (int dir = 0; dir < 2; dir++) {
+				int from = dir ? n : v, to = dir ? v : n;
+				Quadric q = quadrics[from];
+				q += quadrics[to];
+				double cost = q.Error(pos(to));
+				if (attributeCost) {
+					glm::dvec3 edge = pos(to) - pos(from);
+					cost += attributeCost(from, to) * glm::dot(edge, edge) * edgeScale;
+				}
+				heap.push({ cost, from, to, version[from], version[to] });
+			}
+		}
+	};
+	for (int v = 0; v < vertexNum; v++) pushCollapses(v);
+
+	int lodNum = triangleRatios.size() + 1;
+	lodIndices.assign(1, indices);
+	int liveTriangleNum = triangleNum;
+	for (int lod = 1; lod < lodNum; lod++) {
+		int target = (int)(triangleRatios[lod - 1] * triangleNum);
+		while (liveTriangleNum > target && !heap.empty()) {
+			Collapse collapse = heap.top();
+			heap.pop();
+			int from = collapse.from, to = collapse.to;
+			if (isRemoved[from] || isRemoved[to] || version[from] != collapse.fromVersion || version[to] != collapse.toVersion) continue;
+
+			// link condition: the only shared neighbours are the opposite corners of the edge's triangles
+			neighbours(from, around);
+			neighbours(to, aroundTo);
+			int sharedNum = 0, edgeTriangleNum = 0;
+			for (int n : around) sharedNum += std::find(aroundTo.begin(), aroundTo.end(), n) != aroundTo.end();
+			for (int t : vertexTriangles[from]) {
+				if (!isTriangleAlive[t]) continue;
+				if (tris[3 * t] == to || tris[3 * t + 1] == to || tris[3 * t + 2] == to) edgeTriangleNum++;
+			}
+			if (edgeTriangleNum == 0 || sharedNum > edgeTriangleNum) continue;
+
+			// no triangle may flip or collapse to a sliver once from moves onto to
+			bool isValid = true;
+			for (int t : vertexTriangles[from]) {
+				if (!isTriangleAlive[t] || tris[3 * t] == to || tris[3 * t + 1] == to || tris[3 * t + 2] == to) continue;
+				glm::dvec3 before = triangleNormal(t);
+				for (int c = 0; c < 3; c++) {
+					if (tris[3 * t + c] == from) tris[3 * t + c] = to;
+				}
+				glm::dvec3 after = triangleNormal(t);
+				for (int c = 0; c < 3; c++) {
+					if (tris[3 * t + c] == to) tris[3 * t + c] = from;
+				}
+				double lengths = glm::length(before) * glm::length(after);
+				if (lengths <= 0.0 || glm::dot(before, after) < MIN_NORMAL_DOT * lengths) {
+					isValid = false;
+					break;
+				}
+			}
+			if (!isValid) continue;
+
+			// collapse: the edge's triangles die, the others move from -> to
+			for (int t : vertexTriangles[from]) {
+				if (!isTriangleAlive[t]) continue;
+				bool hasTo = tris[3 * t] == to || tris[3 * t + 1] == to || tris[3 * t + 2] == to;
+				if (hasTo) {
+					isTriangleAlive[t] = 0;
+					liveTriangleNum--;
+					continue;
+				}
+				for (int c = 0; c < 3; c++) {
+					if (tris[3 * t + c] == from) tris[3 * t + c] = to;
+				}
+				vertexTriangles[to].push_back(t);
+			}
+			quadrics[to] += quadrics[from];
+			isRemoved[from] = 1;
+			version[to]++;
+			pushCollapses(to);
+		}
+
+		std::vector<unsigned int> lodTriangles;
+		lodTriangles.reserve(3 * liveTriangleNum);
+		for (int t = 0; t < triangleNum; t++) {
+			if (!isTriangleAlive[t]) continue;
+			for (int c = 0; c < 3; c++) lodTriangles.push_back(tris[3 * t + c]);
+		}
+		lodIndices.push_back(lodTriangles);
+	}
+
+	// levels only lose vertices, so the last one using v is the coarsest
+	vertexLOD.assign(vertexNum, 0);
+	for (int lod = 1; lod < lodNum; lod++) {
+		for (unsigned int v : lodIndices[lod]) vertexLOD[v] = lod;
+	}
+}
@@ -1,4 +1,10 @@
 #include "Skeleton.h"
+#include "FastMath.h"
+#include <algorithm>
+#include <cstring>
+#include <xmmintrin.h>
+
+Cube* Skeleton::boxMesh = NULL;
 
 Skeleton::Skeleton()
 {
@@ -18,6 +24,14 @@ bool Skeleton::Load(const char* filename)
 	root = new Joint();
 	root->Load(tknizer);
 	this->BuildJointVector();
+	this->BuildDOFArrays();
+	boxInstanceMtx.resize(joints.size());
+
+	// GL objects can only be created once there is a context, so build the shared cube on first load
+	if (!boxMesh) {
+		boxMesh = new Cube();
+		boxMesh->buildCube(glm::vec3(-0.5f), glm::vec3(0.5f));
+	}
 
 	tknizer->Close();
 	return true;
@@ -25,15 +39,92 @@ bool Skeleton::Load(const char* filename)
 
 void Skeleton::Update(glm::mat4 parentW)
 {
-	root->Update(parentW);
+	// same pose as the last recompute: every W is still valid
+	if (generation > 0 && memcmp(&parentW, &updatedParentW, sizeof(glm::mat4)) == 0
+		&& memcmp(DOFvalues.data(), updatedDOFvalues.data(), sizeof(float) * DOFvalues.size()) == 0) {
+		return;
+	}
+	updatedParentW = parentW;
+	updatedDOFvalues = DOFvalues;
+	generation++;
+
+	// sin & cos of every DOF in one batch, then joints in depth-first order so parents come first
+	FastMath::SinCos(DOFvalues.data(), DOFsines.data(), DOFcosines.data(), DOFvalues.size());
+	for (int i = 0; i < joints.size(); i++) {
+		const glm::mat4& W = joints[i]->parent ? joints[i]->parent->W : parentW;
+		joints[i]->Update(W, &DOFsines[3 * i], &DOFcosines[3 * i]);
+	}
+}
+
+void Skeleton::ComputePoseW(glm::mat4 parentW)
+{
+	if (poseW.size() == joints.size() && memcmp(&parentW, &poseParentW, sizeof(glm::mat4)) == 0
+		&& memcmp(DOFvalues.data(), poseDOFvalues.data(), sizeof(float) * DOFvalues.size()) == 0) {
+		return;
+	}
+	poseParentW = parentW;
+	poseDOFvalues = DOFvalues;
+	poseW.resize(joints.size());
+
+	FastMath::SinCos(DOFvalues.data(), DOFsines.data(), DOFcosines.data(), DOFvalues.size());
+	for (int i = 0; i < joints.size(); i++) {
+		const glm::mat4& W = jointParent[i] >= 0 ? poseW[jointParent[i]] : parentW;
+		poseW[i] = W * Joint::ComputeLocal(joints[i]->offset, &DOFsines[3 * i], &DOFcosines[3 * i]);
+	}
 }
 
 void Skeleton::Draw(const glm::mat4& viewProjMtx, GLuint shader)
 {
-	root->Draw(viewProjMtx, shader);
+	// one instance per joint: world matrix times the box scale & offset, drawn in a single call
+	for (int i = 0; i < joints.size(); i++) {
+		boxInstanceMtx[i] = joints[i]->W * joints[i]->boxMtx;
+	}
+	boxMesh->drawCubeInstanced(boxInstanceMtx, viewProjMtx, shader);
 }
 
 void Skeleton::BuildJointVector()
 {
 	root->BuildJointVector(&joints); // pass in by reference
+	jointParent.resize(joints.size());
+	for (int i = 0; i < joints.size(); i++) {
+		jointParent[i] = joints[i]->parent ? (int)(std::find(joints.begin(), joints.end(), joints[i]->parent) - joints.begin()) : -1;
+	}
+}
+
+void Skeleton::BuildDOFArrays()
+{
+	// sized once, DOFs keep pointers into DOFvalues so it must never reallocate afterwards
+	int DOFnum = 3 * joints.size();
+	DOFvalues.resize(DOFnum);
+	DOFmins.resize(DOFnum);
+	DOFmaxs.resize(DOFnum);
+	DOFsines.resize(DOFnum);
+	DOFcosines.resize(DOFnum);
+	for (int i = 0; i < joints.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			DOF* dof = joints[i]->JointDOF[k];
+			DOFmins[3 * i + k] = dof->DOFmin;
+			DOFmaxs[3 * i + k] = dof->DOFmax;
+			dof->BindStorage(&DOFvalues[3 * i + k]);
+		}
+	}
+}
+
+void Skeleton::SetPose(const float* pose)
+{
+	// clamp 4 DOFs at a time straight from the pose buffer into the DOF array
+	int DOFnum = DOFvalues.size();
+	const float* mins = DOFmins.data();
+	const float* maxs = DOFmaxs.data();
+	float* values = DOFvalues.data();
+	int i = 0;
+	for (; i + 4 <= DOFnum; i += 4) {
+		__m128 val = _mm_loadu_ps(pose + i);
+		val = _mm_max_ps(val, _mm_loadu_ps(mins + i));
+		val = _mm_min_ps(val, _mm_loadu_ps(maxs + i));
+		_mm_storeu_ps(values + i, val);
+	}
+	for (; i < DOFnum; i++) {
+		values[i] = std::min(std::max(pose[i], mins[i]), maxs[i]);
+	}
 }
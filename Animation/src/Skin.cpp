@@ -1,48 +1,149 @@
 #include "Skin.h"
+#include "Shader.h"
+#include "MeshOptimizer.h"
 #include "glm/gtx/string_cast.hpp"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+// Vertices per task; inputs, influences & outputs of a chunk (~110 KB) stay in L2
+static const int SKIN_CHUNK_SIZE = 2048;
+// Dirty ranges closer than this are merged; re-skinning a few clean vertices is cheaper than another range
+static const int SKIN_RANGE_GAP = 32;
+// More pending uploads than this collapse into one upload of the whole mesh
+static const int SKIN_MAX_PENDING_UPLOADS = 64;
+// Uniform buffer binding point of the joint palette
+static const GLuint SKIN_PALETTE_BINDING = 0;
+// Largest accepted difference between GPU and CPU skinning (normals include two 10-bit quantizations)
+static const float SKIN_GPU_POSITION_TOLERANCE = 1e-3f;
+static const float SKIN_GPU_NORMAL_TOLERANCE = 1e-2f;
+
+// Static per-vertex influences of the GPU skinning path, locations 6 (ivec4) and 7 (vec4)
+struct GPUInfluence {
+    uint16_t joints[SKIN_GPU_INFLUENCES];
+    float weights[SKIN_GPU_INFLUENCES];
+};
+
+// Attribute layout of SkinnedVertex in the bound VBO, starting at byte offset 0
+static void SetupSkinnedVertexAttributes()
+{
+    GLuint posLoc = 0;
+    GLuint normLoc = 1;
+    glEnableVertexAttribArray(posLoc);
+    glVertexAttribPointer(posLoc, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, position));
+    glEnableVertexAttribArray(normLoc);
+    glVertexAttribPointer(normLoc, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, normal));
+}
 
 Skin::Skin(Skeleton* skel)
 {
     skeleton = skel;
-    // Generate a vertex array (VAO), two vertex buffer objects (VBO), and EBO.
+    // Generate two vertex array objects (VAO), two vertex buffer objects (VBO), and EBO.
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO_positions);
-    glGenBuffers(1, &VBO_normals);
+    glGenVertexArrays(1, &VAO_bindPose);
+    glGenBuffers(1, &VBO_skinned);
+    glGenBuffers(1, &VBO_bindPose);
     glGenBuffers(1, &EBO);
+    glGenVertexArrays(1, &VAO_gpuSkin);
+    glGenBuffers(1, &VBO_influences);
+    glGenBuffers(1, &UBO_palette);
+    for (int s = 0; s < SKIN_RING_SEGMENTS; s++) {
+        segmentFrame[s] = -1;
+        segmentVertexNum[s] = 0;
+    }
 }
 
 Skin::~Skin()
 {
-    // Delete the VBOs and the VAO.
-    glDeleteBuffers(1, &VBO_positions);
-    glDeleteBuffers(1, &VBO_normals);
+    if (isPersistentMapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_skinned);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    for (int s = 0; s < SKIN_RING_SEGMENTS; s++) {
+        if (segmentFences[s]) glDeleteSync(segmentFences[s]);
+    }
+    // Delete the VBOs and the VAOs.
+    glDeleteBuffers(1, &VBO_skinned);
+    glDeleteBuffers(1, &VBO_bindPose);
     glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO_influences);
+    glDeleteBuffers(1, &UBO_palette);
     glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &VAO_bindPose);
+    glDeleteVertexArrays(1, &VAO_gpuSkin);
 }
 
 void Skin::BindBuffer()
 {
-    // Bind to the VAO.
-    glBindVertexArray(VAO);
-
-    // Bind to the first VBO - positions of vertices
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * shaderPositions.size(), shaderPositions.data(), GL_STATIC_DRAW);
-    GLuint posLoc = 0;
-    glEnableVertexAttribArray(posLoc);
-    glVertexAttribPointer(posLoc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    // Bind pose: static VBO in the same compact format, sent once
+    std::vector<SkinnedVertex> bindPose(vertexNum);
+    for (int i = 0; i < vertexNum; i++) {
+        bindPose[i].position = bindingPositions[i];
+        bindPose[i].normal = SkinningKernel::PackNormal(glm::normalize(bindingNormals[i]));
+    }
+    glBindVertexArray(VAO_bindPose);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_bindPose);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(SkinnedVertex) * vertexNum, bindPose.data(), GL_STATIC_DRAW);
+    SetupSkinnedVertexAttributes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * shaderIndices.size(), shaderIndices.data(), GL_STATIC_DRAW);
 
-    // Bind to the second VBO - normals of vertices
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * shaderNormals.size(), shaderNormals.data(), GL_STATIC_DRAW);
-    GLuint normLoc = 1;
-    glEnableVertexAttribArray(normLoc);
-    glVertexAttribPointer(normLoc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    // Skinned mesh: the ring of segments, written every frame
+    isPersistentMapped = GLEW_ARB_buffer_storage != 0;
+    segmentNum = isPersistentMapped ? SKIN_RING_SEGMENTS : 1;
+    GLsizeiptr ringSize = sizeof(SkinnedVertex) * vertexNum * segmentNum;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_skinned);
+    if (isPersistentMapped) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, ringSize, NULL, flags);
+        skinnedVertices = (SkinnedVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, ringSize, flags);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, ringSize, NULL, GL_DYNAMIC_DRAW);
+        stagingVertices.resize(vertexNum);
+        skinnedVertices = stagingVertices.data();
+    }
+    SetupSkinnedVertexAttributes();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-    // Bind the EBO to the bound VAO and send the data
+    // GPU skinning: the bind pose VBO again, plus the influences; with more than SKIN_GPU_INFLUENCES
+    // per vertex the heaviest are kept and renormalized
+    std::vector<GPUInfluence> influences(vertexNum);
+    int slots[SKIN_MAX_INFLUENCES];
+    for (int i = 0; i < vertexNum; i++) {
+        const uint16_t* jnt = &influenceJoints[i * SKIN_MAX_INFLUENCES];
+        const float* wt = &influenceWeights[i * SKIN_MAX_INFLUENCES];
+        for (int k = 0; k < SKIN_MAX_INFLUENCES; k++) slots[k] = k;
+        float weightSum = 1.0f;
+        if (SKIN_MAX_INFLUENCES > SKIN_GPU_INFLUENCES) {
+            std::sort(slots, slots + SKIN_MAX_INFLUENCES, [wt](int a, int b) { return wt[a] > wt[b]; });
+            weightSum = 0.0f;
+            for (int k = 0; k < SKIN_GPU_INFLUENCES; k++) weightSum += wt[slots[k]];
+        }
+        for (int k = 0; k < SKIN_GPU_INFLUENCES; k++) {
+            bool isUsed = k < SKIN_MAX_INFLUENCES && weightSum > 0.0f;
+            influences[i].joints[k] = isUsed ? jnt[slots[k]] : 0;
+            influences[i].weights[k] = isUsed ? wt[slots[k]] / weightSum : 0.0f;
+        }
+    }
+    glBindVertexArray(VAO_gpuSkin);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_bindPose);
+    SetupSkinnedVertexAttributes();
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_influences);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GPUInfluence) * vertexNum, influences.data(), GL_STATIC_DRAW);
+    GLuint jointLoc = 6;
+    GLuint weightLoc = 7;
+    glEnableVertexAttribArray(jointLoc);
+    glVertexAttribIPointer(jointLoc, SKIN_GPU_INFLUENCES, GL_UNSIGNED_SHORT, sizeof(GPUInfluence), (void*)offsetof(GPUInfluence, joints));
+    glEnableVertexAttribArray(weightLoc);
+    glVertexAttribPointer(weightLoc, SKIN_GPU_INFLUENCES, GL_FLOAT, GL_FALSE, sizeof(GPUInfluence), (void*)offsetof(GPUInfluence, weights));
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * shaderIndices.size(), shaderIndices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO_palette);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * SKIN_MAX_GPU_JOINTS, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
     // Unbind the VBOs.
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -61,14 +162,10 @@ bool Skin::Load(const char* filename)
     tknizer->FindToken("{");
     float px, py, pz;
     for (int i = 0; i < vertexNum; i++) {
-        Vertex* vertex = new Vertex();
         px = tknizer->GetFloat();
         py = tknizer->GetFloat();
         pz = tknizer->GetFloat();
-        vertex->setPositions(px, py, pz);
-        vertices.push_back(vertex);
         bindingPositions.push_back({ px, py, pz });
-        shaderPositions.push_back({ px, py, pz });
     }
 
     // Set normals
@@ -78,23 +175,41 @@ bool Skin::Load(const char* filename)
         nx = tknizer->GetFloat();
         ny = tknizer->GetFloat();
         nz = tknizer->GetFloat();
-        vertices[i]->setNormals(nx, ny, nz);
         bindingNormals.push_back({ nx, ny, nz });
-        shaderNormals.push_back({ nx, ny, nz });
     }
 
     // Set weights
+    // keep the SKIN_MAX_INFLUENCES heaviest influences of each vertex and renormalize them
     tknizer->FindToken("{");
     int attachmentNum, JointID;
     float weight;
+    int prunedNum = 0;
+    std::vector<std::pair<float, int>> attachments;
+    influenceJoints.assign(vertexNum * SKIN_MAX_INFLUENCES + 1, 0); // + spare entry read by the SIMD kernel
+    influenceWeights.assign(vertexNum * SKIN_MAX_INFLUENCES, 0.0f);
     for (int i = 0; i < vertexNum; i++) {
         attachmentNum = tknizer->GetFloat();
+        attachments.clear();
         for (int j = 0; j < attachmentNum; j++) {
             JointID = tknizer->GetFloat();
             weight = tknizer->GetFloat();
-            vertices[i]->weights.push_back(weight);
-            vertices[i]->joints.push_back(skeleton->joints[JointID]);
+            attachments.push_back({ weight, JointID });
+        }
+        if (attachmentNum > SKIN_MAX_INFLUENCES) {
+            std::partial_sort(attachments.begin(), attachments.begin() + SKIN_MAX_INFLUENCES, attachments.end(),
+                [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+            attachments.resize(SKIN_MAX_INFLUENCES);
+            prunedNum += attachmentNum - SKIN_MAX_INFLUENCES;
         }
+        float weightSum = 0.0f;
+        for (auto& attachment : attachments) weightSum += attachment.first;
+        for (int j = 0; j < attachments.size(); j++) {
+            influenceJoints[i * SKIN_MAX_INFLUENCES + j] = attachments[j].second;
+            influenceWeights[i * SKIN_MAX_INFLUENCES + j] = weightSum > 0.0f ? attachments[j].first / weightSum : 0.0f;
+        }
+    }
+    if (prunedNum > 0) {
+        std::cout << "Pruned " << prunedNum << " skin influences beyond " << SKIN_MAX_INFLUENCES << " per vertex" << std::endl;
     }
 
     // Set indices/triangles
@@ -110,6 +225,23 @@ bool Skin::Load(const char* filename)
         shaderIndices.push_back(v1);
         shaderIndices.push_back(v2);
     }
+#if SKIN_OPTIMIZE_MESH
+    OptimizeMesh();
+#endif
+    BuildLODs();
+    // reverse index, counting sort of the (vertex, joint) pairs by joint
+    jointVertexStart.assign(skeleton->joints.size() + 1, 0);
+    for (int k = 0; k < vertexNum * SKIN_MAX_INFLUENCES; k++) {
+        if (influenceWeights[k] > 0.0f) jointVertexStart[influenceJoints[k] + 1]++;
+    }
+    for (int j = 0; j < skeleton->joints.size(); j++) jointVertexStart[j + 1] += jointVertexStart[j];
+    jointVertices.resize(jointVertexStart.back());
+    std::vector<int> fill(jointVertexStart.begin(), jointVertexStart.end() - 1);
+    for (int k = 0; k < vertexNum * SKIN_MAX_INFLUENCES; k++) {
+        if (influenceWeights[k] > 0.0f) jointVertices[fill[influenceJoints[k]]++] = k / SKIN_MAX_INFLUENCES;
+    }
+    isVertexDirty.assign(vertexNum, 0);
+    jointChangedFrame.assign(skeleton->joints.size(), 0);
 
     // Set binding matrices (one binding matrix to one joint)
     tknizer->FindToken("bindings");
@@ -145,35 +277,365 @@ bool Skin::Load(const char* filename)
     return true;
 }
 
+void Skin::OptimizeMesh()
+{
+    float acmrBefore = MeshOptimizer::ComputeACMR(shaderIndices, vertexNum);
+    MeshOptimizer::OptimizeVertexCache(shaderIndices, vertexNum);
+    float acmrAfter = MeshOptimizer::ComputeACMR(shaderIndices, vertexNum);
+    RemapVertices(MeshOptimizer::OptimizeVertexFetch(shaderIndices, vertexNum));
+    std::cout << "Optimized skin mesh: ACMR " << acmrBefore << " -> " << acmrAfter
+        << " (" << MeshOptimizer::CACHE_SIZE << "-entry FIFO), vertices in first-use order" << std::endl;
+}
+
+void Skin::BuildLODs()
+{
+    // bounding sphere of the bind pose, for LOD selection
+    glm::vec3 minCorner = bindingPositions.empty() ? glm::vec3(0.0f) : bindingPositions[0];
+    glm::vec3 maxCorner = minCorner;
+    for (auto& p : bindingPositions) {
+        minCorner = glm::min(minCorner, p);
+        maxCorner = glm::max(maxCorner, p);
+    }
+    boundCenter = 0.5f * (minCorner + maxCorner);
+    boundRadius = 0.0f;
+    for (auto& p : bindingPositions) boundRadius = std::max(boundRadius, glm::length(p - boundCenter));
+
+    lodNum = 1;
+    lodIndexStart[0] = 0;
+    lodIndexStart[1] = shaderIndices.size();
+    lodVertexNum[0] = vertexNum;
+    if (SKIN_LOD_NUM <= 1) return;
+
+    // penalize merging vertices with different skin weights, which would drag them along the wrong joint:
+    // the L1 distance between the two weight vectors over the union of their non-zero influences (unused
+    // slots are weight 0, joint 0, and must not match a real joint 0), so d(a, b) == d(b, a)
+    auto weightDistance = [this](int a, int b) {
+        auto weightOf = [this](int v, int joint) {
+            float w = 0.0f;
+            for (int l = 0; l < SKIN_MAX_INFLUENCES; l++) {
+                if (influenceJoints[v * SKIN_MAX_INFLUENCES + l] == joint) w += influenceWeights[v * SKIN_MAX_INFLUENCES + l];
+            }
+            return w;
+        };
+        int joints[2 * SKIN_MAX_INFLUENCES];
+        int jointNum = 0;
+        for (int v : { a, b }) {
+            for (int k = 0; k < SKIN_MAX_INFLUENCES; k++) {
+                int joint = influenceJoints[v * SKIN_MAX_INFLUENCES + k];
+                if (influenceWeights[v * SKIN_MAX_INFLUENCES + k] > 0.0f
+                    && std::find(joints, joints + jointNum, joint) == joints + jointNum) joints[jointNum++] = joint;
+            }
+        }
+        float distance = 0.0f;
+        for (int i = 0; i < jointNum; i++) distance += std::abs(weightOf(a, joints[i]) - weightOf(b, joints[i]));
+        return distance;
+    };
+    std::vector<float> ratios;
+    for (int k = 1; k < SKIN_LOD_NUM; k++) ratios.push_back(std::ldexp(1.0f, -k));
+    std::vector<std::vector<unsigned int>> lodIndices;
+    std::vector<int> vertexLOD;
+    MeshOptimizer::SimplifyLODs(shaderIndices, bindingPositions, ratios, weightDistance, lodIndices, vertexLOD);
+
+    // vertices kept by coarser levels first, in their current (first-use) order within a level
+    std::vector<int> order(vertexNum);
+    for (int i = 0; i < vertexNum; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&vertexLOD](int a, int b) { return vertexLOD[a] > vertexLOD[b]; });
+    std::vector<int> remap(vertexNum);
+    for (int i = 0; i < vertexNum; i++) remap[order[i]] = i;
+    lodNum = lodIndices.size();
+    shaderIndices.clear();
+    for (int k = 0; k < lodNum; k++) {
+        for (unsigned int& v : lodIndices[k]) v = remap[v];
+        if (k > 0) MeshOptimizer::OptimizeVertexCache(lodIndices[k], vertexNum);
+        lodIndexStart[k] = shaderIndices.size();
+        shaderIndices.insert(shaderIndices.end(), lodIndices[k].begin(), lodIndices[k].end());
+        lodVertexNum[k] = 0;
+        for (int v = 0; v < vertexNum; v++) lodVertexNum[k] += vertexLOD[v] >= k;
+    }
+    lodIndexStart[lodNum] = shaderIndices.size();
+    RemapVertices(remap);
+    std::cout << "Skin LODs (vertices / triangles):";
+    for (int k = 0; k < lodNum; k++) {
+        std::cout << " " << lodVertexNum[k] << " / " << (lodIndexStart[k + 1] - lodIndexStart[k]) / 3;
+    }
+    std::cout << std::endl;
+}
+
+void Skin::RemapVertices(const std::vector<int>& remap)
+{
+    std::vector<glm::vec3> positions(vertexNum), normals(vertexNum);
+    std::vector<uint16_t> joints(influenceJoints.size(), 0);
+    std::vector<float> weights(influenceWeights.size());
+    for (int i = 0; i < vertexNum; i++) {
+        int n = remap[i];
+        positions[n] = bindingPositions[i];
+        normals[n] = bindingNormals[i];
+        for (int k = 0; k < SKIN_MAX_INFLUENCES; k++) {
+            joints[n * SKIN_MAX_INFLUENCES + k] = influenceJoints[i * SKIN_MAX_INFLUENCES + k];
+            weights[n * SKIN_MAX_INFLUENCES + k] = influenceWeights[i * SKIN_MAX_INFLUENCES + k];
+        }
+    }
+    bindingPositions.swap(positions);
+    bindingNormals.swap(normals);
+    influenceJoints.swap(joints);
+    influenceWeights.swap(weights);
+}
+
+void Skin::SelectLOD(float screenSize)
+{
+    if (lodOverride >= 0) {
+        lod = std::min(lodOverride, lodNum - 1);
+        return;
+    }
+    // one level coarser each time the size halves below SKIN_LOD_SCREEN_SIZE
+    lod = 0;
+    for (float size = SKIN_LOD_SCREEN_SIZE; lod < lodNum - 1 && screenSize < size; size *= 0.5f) lod++;
+}
+
+glm::vec3 Skin::GetBoundCenter()
+{
+    if (palette.empty()) return boundCenter;
+    return glm::vec3(palette[0] * glm::vec4(boundCenter, 1.0f));
+}
+
 void Skin::Update()
 {
     // Two loop;
-    // Compute matrix for each joint of the current vertex;
-    // Compute blended world space positions & normals for each vertex;
-    Vertex* curV;
-    glm::vec3 curPosition;
-    glm::vec3 curNormal;
-    glm::mat4 M;
-    glm::vec4 transformedPosition;
-    glm::vec4 transformedNormal;
+    // Compute skinning matrix (W * inverseB) once for each joint;
+    // Blend the matrices of each vertex by weight and transform its position & normal;
+    auto startTime = std::chrono::steady_clock::now();
 
-    for (int i = 0; i < vertexNum; i++) {
-        curV = vertices[i];
-        curPosition = curV->position;
-        curNormal = curV->normal;
-        transformedPosition = glm::vec4(0.0f);
-        transformedNormal = glm::vec4(0.0f);
+    // joint matrices first, so the vertex loop only blends them by weight
+    if (paletteGeneration != skeleton->generation) {
+        palette.resize(skeleton->joints.size());
+        for (int j = 0; j < skeleton->joints.size(); j++) {
+            palette[j] = skeleton->joints[j]->W * skeleton->joints[j]->inverseB;
+        }
+        paletteGeneration = skeleton->generation;
+    }
+    if (isGPUSkinning) {
+        // the vertex shader blends; the ring is left as is and catches up (from prevPalette) when
+        // switching back to the CPU path
+        skinnedVertexNum = 0;
+        skinMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        return;
+    }
+
+    // still pose: the ring already holds it, unless a finer LOD needs vertices it has not skinned
+    activeVertexNum = lodVertexNum[lod];
+    skinnedVertexNum = 0;
+    if (ringGeneration == paletteGeneration && readySegment >= 0 && segmentVertexNum[readySegment] >= activeVertexNum) {
+        skinMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        return;
+    }
+    ringGeneration = paletteGeneration;
 
-        for (int j = 0; j < curV->joints.size(); j++) {
-            M = curV->weights[j] * curV->joints[j]->W * curV->joints[j]->inverseB;
-            transformedPosition += M * glm::vec4(curPosition, 1.0f);
-            transformedNormal += M * glm::vec4(curNormal, 0.0f);
+    // record which joints moved in this update
+    updateFrame++;
+    bool isAnyChanged = false;
+    for (int j = 0; j < palette.size(); j++) {
+        if (j < prevPalette.size() && memcmp(&palette[j], &prevPalette[j], sizeof(glm::mat4)) == 0) continue;
+        jointChangedFrame[j] = updateFrame;
+        isAnyChanged = true;
+    }
+    prevPalette = palette;
+    if (!isAnyChanged && readySegment >= 0 && segmentVertexNum[readySegment] >= activeVertexNum) {
+        // the segment on screen is still current
+        skinMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        return;
+    }
+
+    // take the segment Draw cleared; if there was no draw since the last update, the ready
+    // segment has not been handed to the GPU again and can be rewritten in place
+    int segment = writeSegment >= 0 ? writeSegment : readySegment;
+    // a segment skinned at a coarser LOD lacks the extra vertices, so it is skinned whole
+    FindDirtyRanges(segmentVertexNum[segment] >= activeVertexNum ? segmentFrame[segment] : -1);
+    skinChunks.clear();
+    for (auto& range : dirtyRanges) {
+        for (int begin = range.first; begin < range.second; begin += SKIN_CHUNK_SIZE) {
+            skinChunks.push_back({ begin, std::min(begin + SKIN_CHUNK_SIZE, range.second) });
         }
+        skinnedVertexNum += range.second - range.first;
+    }
+
+    // all arrays are walked front to back, a fixed number of influences per vertex;
+    // the kernel writes finished (normalized & packed) vertices straight into the segment
+    SkinnedVertex* out = skinnedVertices + segment * vertexNum;
+    auto skinChunk = [this, out](int first, int last) {
+        for (int c = first; c < last; c++) {
+            SkinningKernel::SkinRange(kernelMode, skinChunks[c].first, skinChunks[c].second, SKIN_MAX_INFLUENCES,
+                palette.data(), influenceJoints.data(), influenceWeights.data(),
+                bindingPositions.data(), bindingNormals.data(), out);
+        }
+    };
+    if (scheduler) {
+        scheduler->ParallelFor(skinChunks.size(), 1, skinChunk);
+    }
+    else {
+        skinChunk(0, skinChunks.size());
+    }
 
-        shaderPositions[i] = glm::vec3(transformedPosition);
-        transformedNormal = glm::normalize(transformedNormal);
-        shaderNormals[i] = glm::vec3(transformedNormal);
+    segmentFrame[segment] = updateFrame;
+    segmentVertexNum[segment] = activeVertexNum;
+    readySegment = segment;
+    if (isPersistentMapped) {
+        writeSegment = -1;
     }
+    else {
+        pendingUploads.insert(pendingUploads.end(), dirtyRanges.begin(), dirtyRanges.end());
+        if (pendingUploads.size() > SKIN_MAX_PENDING_UPLOADS) {
+            pendingUploads.assign(1, { 0, activeVertexNum });
+        }
+    }
+    skinMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void Skin::FindDirtyRanges(int sinceFrame)
+{
+    dirtyRanges.clear();
+    if (sinceFrame < 0) {
+        dirtyRanges.push_back({ 0, activeVertexNum });
+        return;
+    }
+
+    bool isAnyChanged = false;
+    for (int j = 0; j < jointChangedFrame.size(); j++) {
+        if (jointChangedFrame[j] <= sinceFrame) continue;
+        isAnyChanged = true;
+        for (int k = jointVertexStart[j]; k < jointVertexStart[j + 1]; k++) {
+            isVertexDirty[jointVertices[k]] = 1;
+        }
+    }
+    if (!isAnyChanged) return;
+
+    // collect runs of dirty vertices, clearing the marks on the way
+    for (int i = 0; i < vertexNum;) {
+        if (!isVertexDirty[i]) {
+            i++;
+            continue;
+        }
+        int begin = i;
+        while (i < vertexNum && isVertexDirty[i]) isVertexDirty[i++] = 0;
+        // vertices past the current LOD are only unmarked
+        int end = std::min(i, activeVertexNum);
+        if (begin >= end) continue;
+        if (!dirtyRanges.empty() && begin - dirtyRanges.back().second <= SKIN_RANGE_GAP) {
+            dirtyRanges.back().second = end;
+        }
+        else {
+            dirtyRanges.push_back({ begin, end });
+        }
+    }
+}
+
+const SkinnedVertex* Skin::GetSkinnedVertices()
+{
+    return skinnedVertices + std::max(readySegment, 0) * vertexNum;
+}
+
+bool Skin::CanGPUSkin()
+{
+    return skeleton->joints.size() <= SKIN_MAX_GPU_JOINTS;
+}
+
+void Skin::UploadPalette(GLuint shader)
+{
+    // orphan the block, so a new palette does not wait for draws still reading the last one;
+    // an unchanged one stays where it is
+    if (uploadedGeneration != paletteGeneration) {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO_palette);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * SKIN_MAX_GPU_JOINTS, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4) * palette.size(), palette.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploadedGeneration = paletteGeneration;
+    }
+    glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "JointPalette"), SKIN_PALETTE_BINDING);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SKIN_PALETTE_BINDING, UBO_palette);
+}
+
+bool Skin::CompareGPUSkinning(const char* shaderFile)
+{
+    if (palette.empty() || !CanGPUSkin()) return false;
+
+    // CPU: the current pose skinned from scratch
+    std::vector<SkinnedVertex> cpuVertices(vertexNum);
+    SkinningKernel::SkinRange(SkinningKernel::eReference, 0, vertexNum, SKIN_MAX_INFLUENCES,
+        palette.data(), influenceJoints.data(), influenceWeights.data(),
+        bindingPositions.data(), bindingNormals.data(), cpuVertices.data());
+
+    // GPU: vertex stage only, capturing fragPosition & fragNormal (ModelMtx is left at identity)
+    Shader vertexShader(shaderFile, Shader::eVertex);
+    if (!vertexShader.shaderID) return false;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader.shaderID);
+    const char* varyings[] = { "fragPosition", "fragNormal" };
+    glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    GLint isProgramLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &isProgramLinked);
+    if (!isProgramLinked) {
+        std::cerr << "GPU skinning check: transform feedback program failed to link" << std::endl;
+        glDeleteProgram(program);
+        return false;
+    }
+
+    GLuint feedbackBuffer;
+    glGenBuffers(1, &feedbackBuffer);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, feedbackBuffer);
+    glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, sizeof(glm::vec3) * 2 * vertexNum, NULL, GL_STATIC_READ);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, feedbackBuffer);
+    glUseProgram(program);
+    UploadPalette(program);
+    glUniform1i(glGetUniformLocation(program, "IsSkinned"), GL_TRUE);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(VAO_gpuSkin);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, vertexNum);
+    glEndTransformFeedback();
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    std::vector<glm::vec3> gpuVertices(2 * vertexNum);
+    glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, sizeof(glm::vec3) * 2 * vertexNum, gpuVertices.data());
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+    glDeleteBuffers(1, &feedbackBuffer);
+    glUseProgram(0);
+    glDeleteProgram(program);
+
+    // normals are compared as directions; both sides start from 10-bit inputs or outputs
+    gpuPositionError = 0.0f;
+    gpuNormalError = 0.0f;
+    for (int i = 0; i < vertexNum; i++) {
+        gpuPositionError = std::max(gpuPositionError, glm::length(gpuVertices[2 * i] - cpuVertices[i].position));
+        glm::vec3 gpuNormal = gpuVertices[2 * i + 1];
+        float len = glm::length(gpuNormal);
+        if (len > 0.0f) gpuNormal /= len;
+        gpuNormalError = std::max(gpuNormalError, glm::length(gpuNormal - SkinningKernel::UnpackNormal(cpuVertices[i].normal)));
+    }
+    bool isMatched = gpuPositionError <= SKIN_GPU_POSITION_TOLERANCE && gpuNormalError <= SKIN_GPU_NORMAL_TOLERANCE;
+    std::cout << "GPU skinning check (" << glGetString(GL_RENDERER) << "): max position error " << gpuPositionError
+        << ", max normal error " << gpuNormalError << " over " << vertexNum << " vertices"
+        << (isMatched ? "" : " - MISMATCH") << std::endl;
+    return isMatched;
+}
+
+glm::vec3 Skin::ComputeJointTip(int joint)
+{
+    Joint* jnt = skeleton->joints[joint];
+    glm::vec3 tip = glm::vec3(0.0f);
+    float maxDist = 0.0f;
+    for (int i = 0; i < vertexNum; i++) {
+        for (int j = 0; j < SKIN_MAX_INFLUENCES; j++) {
+            int k = i * SKIN_MAX_INFLUENCES + j;
+            if (influenceJoints[k] != joint || influenceWeights[k] <= 0.5f) continue;
+            glm::vec3 local = glm::vec3(jnt->inverseB * glm::vec4(bindingPositions[i], 1.0f));
+            if (glm::length(local) > maxDist) {
+                maxDist = glm::length(local);
+                tip = local;
+            }
+        }
+    }
+    return tip;
 }
 
 void Skin::Draw(bool isDrawOriginalSkin, const glm::mat4& viewProjMtx, GLuint shader)
@@ -190,35 +652,72 @@ void Skin::Draw(bool isDrawOriginalSkin, const glm::mat4& viewProjMtx, GLuint sh
     glUniformMatrix4fv(glGetUniformLocation(shader, "ModelViewProjectionMtx"), 1, GL_FALSE, (float*)&mvpMtx);
     glUniform3fv(glGetUniformLocation(shader, "AmbientColor"), 1, &ambientColor[0]);
     
-    // rebind and resend new data after transforming positions and normals
-    // Rebind the VAO
-    glBindVertexArray(VAO);
-
-    // Update the first VBO - positions of vertices - then unbind
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
     if (isDrawOriginalSkin) {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * bindingPositions.size(), bindingPositions.data(), GL_STATIC_DRAW);
+        // static bind pose buffer, nothing to send
+        glBindVertexArray(VAO_bindPose);
+        glDrawElements(GL_TRIANGLES, lodIndexStart[1], GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+        return;
     }
-    else {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * shaderPositions.size(), shaderPositions.data(), GL_STATIC_DRAW);
-
+    // index range of the current level of detail
+    GLsizei lodIndexCount = lodIndexStart[lod + 1] - lodIndexStart[lod];
+    void* lodIndexOffset = (void*)(sizeof(unsigned int) * lodIndexStart[lod]);
+    if (isGPUSkinning) {
+        if (palette.empty()) {
+            glUseProgram(0);
+            return;
+        }
+        // a few KB of matrices instead of the mesh; the shader blends the static bind pose
+        UploadPalette(shader);
+        GLint isSkinnedLoc = glGetUniformLocation(shader, "IsSkinned");
+        glUniform1i(isSkinnedLoc, GL_TRUE);
+        glBindVertexArray(VAO_gpuSkin);
+        glDrawElements(GL_TRIANGLES, lodIndexCount, GL_UNSIGNED_INT, lodIndexOffset);
+        glBindVertexArray(0);
+        glUniform1i(isSkinnedLoc, GL_FALSE);
+        glUseProgram(0);
+        return;
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Update the second VBO - normals of vertices - then unbind
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
-    if (isDrawOriginalSkin) {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * bindingNormals.size(), bindingNormals.data(), GL_STATIC_DRAW);
+    if (readySegment < 0) {
+        glUseProgram(0);
+        return;
     }
-    else {
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * shaderNormals.size(), shaderNormals.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(VAO);
+    if (!isPersistentMapped) {
+        // only the vertex ranges skinned since the last draw, overlapping ones merged
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_skinned);
+        std::sort(pendingUploads.begin(), pendingUploads.end());
+        for (int r = 0; r < pendingUploads.size();) {
+            int begin = pendingUploads[r].first, end = pendingUploads[r].second;
+            for (r++; r < pendingUploads.size() && pendingUploads[r].first <= end; r++) {
+                end = std::max(end, pendingUploads[r].second);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(SkinnedVertex) * begin, sizeof(SkinnedVertex) * (end - begin), &stagingVertices[begin]);
+        }
+        pendingUploads.clear();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // draw the points using triangles, indexed with the EBO
-    glDrawElements(GL_TRIANGLES, shaderIndices.size(), GL_UNSIGNED_INT, 0);
+    // draw the points using triangles, indexed with the EBO; the base vertex selects the segment
+    glDrawElementsBaseVertex(GL_TRIANGLES, lodIndexCount, GL_UNSIGNED_INT, lodIndexOffset, readySegment * vertexNum);
+
+    if (isPersistentMapped) {
+        // fence this draw, then clear the next segment for the coming update; its fence is
+        // from SKIN_RING_SEGMENTS - 1 draws ago and has normally passed already
+        if (segmentFences[readySegment]) glDeleteSync(segmentFences[readySegment]);
+        segmentFences[readySegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        int next = (readySegment + 1) % segmentNum;
+        if (segmentFences[next]) {
+            while (glClientWaitSync(segmentFences[next], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(segmentFences[next]);
+            segmentFences[next] = 0;
+        }
+        writeSegment = next;
+    }
 
     // Unbind the VAO and shader program
     glBindVertexArray(0);
     glUseProgram(0);
-}
\ No newline at end of file
+}
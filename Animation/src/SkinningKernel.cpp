@@ -0,0 +1,225 @@
+////////////////////////////////////////
+// SkinningKernel.cpp
+////////////////////////////////////////
+
+#include "SkinningKernel.h"
+#include <cmath>
+#include <algorithm>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// GCC & Clang only emit AVX2 / FMA code inside functions marked for it; MSVC always can
+#if defined(__GNUC__) || defined(__clang__)
+#define SKINNING_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define SKINNING_AVX2_TARGET
+#endif
+
+namespace {
+	// Matrix entries used by skinning: rows 0-2 of the 4 columns, as offsets into a glm::mat4
+	const int ENTRY_OFFSET[12] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14 };
+
+	void SkinScalar(int begin, int end, int influenceNum, const glm::mat4* palette,
+		const uint16_t* joints, const float* weights, const glm::vec3* inPositions,
+		const glm::vec3* inNormals, SkinnedVertex* out)
+	{
+		for (int i = begin; i < end; i++) {
+			const uint16_t* jnt = joints + i * influenceNum;
+			const float* wt = weights + i * influenceNum;
+			glm::mat4 M = wt[0] * palette[jnt[0]];
+			for (int k = 1; k < influenceNum; k++) {
+				M += wt[k] * palette[jnt[k]];
+			}
+			out[i].position = glm::vec3(M * glm::vec4(inPositions[i], 1.0f));
+			glm::vec3 normal = glm::vec3(M * glm::vec4(inNormals[i], 0.0f));
+			float len = glm::length(normal);
+			out[i].normal = SkinningKernel::PackNormal(len > 0.0f ? normal / len : normal);
+		}
+	}
+
+	// Same operations in the same order as SkinAVX2, one lane at a time
+	void SkinReference(int begin, int end, int influenceNum, const glm::mat4* palette,
+		const uint16_t* joints, const float* weights, const glm::vec3* inPositions,
+		const glm::vec3* inNormals, SkinnedVertex* out)
+	{
+		float m[12];
+		for (int i = begin; i < end; i++) {
+			const uint16_t* jnt = joints + i * influenceNum;
+			const float* wt = weights + i * influenceNum;
+			const float* P = &palette[jnt[0]][0][0];
+			for (int e = 0; e < 12; e++) m[e] = wt[0] * P[ENTRY_OFFSET[e]];
+			for (int k = 1; k < influenceNum; k++) {
+				P = &palette[jnt[k]][0][0];
+				for (int e = 0; e < 12; e++) m[e] = std::fma(wt[k], P[ENTRY_OFFSET[e]], m[e]);
+			}
+			const glm::vec3& p = inPositions[i];
+			const glm::vec3& n = inNormals[i];
+			float normal[3];
+			for (int r = 0; r < 3; r++) {
+				out[i].position[r] = std::fma(m[r], p.x, std::fma(m[3 + r], p.y, std::fma(m[6 + r], p.z, m[9 + r])));
+				normal[r] = std::fma(m[r], n.x, std::fma(m[3 + r], n.y, m[6 + r] * n.z));
+			}
+			// normalize with correctly rounded sqrt & divide, then quantize to 10 bits
+			float len2 = std::fma(normal[0], normal[0], std::fma(normal[1], normal[1], normal[2] * normal[2]));
+			float invLen = len2 > 0.0f ? 1.0f / std::sqrt(len2) : 0.0f;
+			uint32_t packed = 0;
+			for (int r = 0; r < 3; r++) {
+				float c = std::min(std::max(normal[r] * invLen * 511.0f, -511.0f), 511.0f);
+				packed |= ((uint32_t)(int)std::nearbyint(c) & 0x3FF) << (10 * r);
+			}
+			out[i].normal = packed;
+		}
+	}
+
+	// 8 vertices per iteration, returns the first vertex it did not process
+	SKINNING_AVX2_TARGET
+	int SkinAVX2(int begin, int end, int influenceNum, const glm::mat4* palette,
+		const uint16_t* joints, const float* weights, const glm::vec3* inPositions,
+		const glm::vec3* inNormals, SkinnedVertex* out)
+	{
+		const float* paletteBase = &palette[0][0][0];
+		const __m256i laneVec3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		const __m256i laneInfluence = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(influenceNum));
+		const __m256i mask10 = _mm256_set1_epi32(0x3FF);
+		__m256 m[12];
+
+		int i = begin;
+		for (; i + 8 <= end; i += 8) {
+			const uint16_t* jnt = joints + i * influenceNum;
+			for (int k = 0; k < influenceNum; k++) {
+				// palette offset (in floats) of each lane's k-th joint; the 32-bit gather picks up
+				// the next uint16 as well, which is masked off (hence the spare entry at the end)
+				__m256i idx = _mm256_i32gather_epi32((const int*)(jnt + k), laneInfluence, 2);
+				idx = _mm256_slli_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(0xFFFF)), 4);
+				__m256 w = _mm256_i32gather_ps(weights + i * influenceNum + k, laneInfluence, 4);
+				for (int e = 0; e < 12; e++) {
+					__m256 P = _mm256_i32gather_ps(paletteBase + ENTRY_OFFSET[e], idx, 4);
+					m[e] = k == 0 ? _mm256_mul_ps(w, P) : _mm256_fmadd_ps(w, P, m[e]);
+				}
+			}
+
+			// normal first, so few registers are live next to the 12 matrix entries
+			const float* norm = &inNormals[i].x;
+			__m256 nx = _mm256_i32gather_ps(norm, laneVec3, 4);
+			__m256 ny = _mm256_i32gather_ps(norm + 1, laneVec3, 4);
+			__m256 nz = _mm256_i32gather_ps(norm + 2, laneVec3, 4);
+			__m256 normal[3];
+			for (int r = 0; r < 3; r++) {
+				normal[r] = _mm256_fmadd_ps(m[r], nx, _mm256_fmadd_ps(m[3 + r], ny, _mm256_mul_ps(m[6 + r], nz)));
+			}
+
+			// normalize (zero stays zero), scale to [-511, 511], round to nearest and pack
+			__m256 len2 = _mm256_fmadd_ps(normal[0], normal[0], _mm256_fmadd_ps(normal[1], normal[1], _mm256_mul_ps(normal[2], normal[2])));
+			__m256 invLen = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+			invLen = _mm256_and_ps(invLen, _mm256_cmp_ps(len2, _mm256_setzero_ps(), _CMP_GT_OQ));
+			__m256i packed = _mm256_setzero_si256();
+			for (int r = 0; r < 3; r++) {
+				__m256 c = _mm256_mul_ps(_mm256_mul_ps(normal[r], invLen), _mm256_set1_ps(511.0f));
+				c = _mm256_min_ps(_mm256_max_ps(c, _mm256_set1_ps(-511.0f)), _mm256_set1_ps(511.0f));
+				__m256i q = _mm256_and_si256(_mm256_cvtps_epi32(c), mask10);
+				packed = _mm256_or_si256(packed, _mm256_slli_epi32(q, 10 * r));
+			}
+
+			const float* pos = &inPositions[i].x;
+			__m256 px = _mm256_i32gather_ps(pos, laneVec3, 4);
+			__m256 py = _mm256_i32gather_ps(pos + 1, laneVec3, 4);
+			__m256 pz = _mm256_i32gather_ps(pos + 2, laneVec3, 4);
+			__m256 position[3];
+			for (int r = 0; r < 3; r++) {
+				position[r] = _mm256_fmadd_ps(m[r], px, _mm256_fmadd_ps(m[3 + r], py, _mm256_fmadd_ps(m[6 + r], pz, m[9 + r])));
+			}
+
+			// transpose the x, y, z, normal rows into 8 interleaved 16-byte vertices
+			__m256 t0 = _mm256_unpacklo_ps(position[0], position[1]);
+			__m256 t1 = _mm256_unpackhi_ps(position[0], position[1]);
+			__m256 t2 = _mm256_unpacklo_ps(position[2], _mm256_castsi256_ps(packed));
+			__m256 t3 = _mm256_unpackhi_ps(position[2], _mm256_castsi256_ps(packed));
+			__m256 v0 = _mm256_shuffle_ps(t0, t2, 0x44);
+			__m256 v1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+			__m256 v2 = _mm256_shuffle_ps(t1, t3, 0x44);
+			__m256 v3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+			float* dst = &out[i].position.x;
+			_mm256_storeu_ps(dst, _mm256_permute2f128_ps(v0, v1, 0x20));
+			_mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(v2, v3, 0x20));
+			_mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+			_mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+		}
+		return i;
+	}
+
+	bool DetectAVX2()
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		bool hasFMA = (info[2] & (1 << 12)) != 0;
+		bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		bool hasAVX = (info[2] & (1 << 28)) != 0;
+		// the OS has to save the YMM registers on context switches
+		if (!hasFMA || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+}
+
+uint32_t SkinningKernel::PackNormal(const glm::vec3& n)
+{
+	uint32_t packed = 0;
+	for (int r = 0; r < 3; r++) {
+		float c = glm::clamp(n[r], -1.0f, 1.0f) * 511.0f;
+		packed |= ((uint32_t)(int)std::nearbyint(c) & 0x3FF) << (10 * r);
+	}
+	return packed;
+}
+
+glm::vec3 SkinningKernel::UnpackNormal(uint32_t packed)
+{
+	glm::vec3 n;
+	for (int r = 0; r < 3; r++) {
+		// sign-extend the 10-bit field
+		int c = (int)(packed << (22 - 10 * r)) >> 22;
+		n[r] = std::max(c / 511.0f, -1.0f);
+	}
+	return n;
+}
+
+bool SkinningKernel::HasAVX2()
+{
+	static const bool hasAVX2 = DetectAVX2();
+	return hasAVX2;
+}
+
+SkinningKernel::Mode SkinningKernel::Resolve(Mode mode)
+{
+	if (mode == eAuto) return HasAVX2() ? eAVX2 : eScalar;
+	if (mode == eAVX2 && !HasAVX2()) return eReference;
+	return mode;
+}
+
+void SkinningKernel::SkinRange(Mode mode, int begin, int end, int influenceNum,
+	const glm::mat4* palette, const uint16_t* joints, const float* weights,
+	const glm::vec3* inPositions, const glm::vec3* inNormals, SkinnedVertex* out)
+{
+	switch (Resolve(mode)) {
+	case eAVX2:
+		begin = SkinAVX2(begin, end, influenceNum, palette, joints, weights, inPositions, inNormals, out);
+		SkinReference(begin, end, influenceNum, palette, joints, weights, inPositions, inNormals, out);
+		break;
+	case eReference:
+		SkinReference(begin, end, influenceNum, palette, joints, weights, inPositions, inNormals, out);
+		break;
+	default:
+		SkinScalar(begin, end, influenceNum, palette, joints, weights, inPositions, inNormals, out);
+		break;
+	}
+}
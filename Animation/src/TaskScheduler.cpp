@@ -0,0 +1,186 @@
+////////////////////////////////////////
+// TaskScheduler.cpp
+////////////////////////////////////////
+
+#include "TaskScheduler.h"
+#include <algorithm>
+
+struct TaskScheduler::Task {
+	std::function<void()> fn;
+	std::atomic<int> pendingDeps;   // unfinished dependencies, plus one while the task is being added
+	std::vector<Task*> successors;  // tasks waiting on this one
+	bool isDone;
+	std::atomic<int>* group;        // counter of a ParallelFor, NULL otherwise
+};
+
+namespace {
+	// Queue of the current thread; worker threads set this once, all other threads use queue 0
+	thread_local const TaskScheduler* tlsScheduler = NULL;
+	thread_local int tlsQueue = 0;
+}
+
+TaskScheduler::TaskScheduler(int workerNum)
+{
+	if (workerNum <= 0) {
+		workerNum = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+	}
+	pendingTasks = 0;
+	readyTasks = 0;
+	isQuit = false;
+	queues.resize(workerNum + 1);
+	for (int i = 0; i < workerNum; i++) {
+		workers.emplace_back(&TaskScheduler::WorkerLoop, this, i + 1);
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	Wait();
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		isQuit = true;
+	}
+	wakeCondition.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+TaskScheduler::TaskHandle TaskScheduler::AddTask(std::function<void()> fn, std::initializer_list<TaskHandle> deps)
+{
+	Task* task;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		taskPool.emplace_back();
+		task = &taskPool.back();
+		task->fn = std::move(fn);
+		task->pendingDeps = 1;
+		task->isDone = false;
+		task->group = NULL;
+		for (Task* dep : deps) {
+			if (dep && !dep->isDone) {
+				dep->successors.push_back(task);
+				task->pendingDeps++;
+			}
+		}
+		pendingTasks++;
+	}
+	// drop the guard count; queue it right away if nothing is left to wait for
+	if (--task->pendingDeps == 0) Push(task);
+	return task;
+}
+
+void TaskScheduler::ParallelFor(int count, int grainSize, const std::function<void(int, int)>& fn)
+{
+	grainSize = std::max(grainSize, 1);
+	if (count <= grainSize || workers.empty()) {
+		fn(0, count);
+		return;
+	}
+	int chunkNum = (count + grainSize - 1) / grainSize;
+	std::atomic<int> group(chunkNum);
+	// the calling thread keeps the first chunk for itself
+	for (int c = 1; c < chunkNum; c++) {
+		int begin = c * grainSize;
+		int end = std::min(begin + grainSize, count);
+		Task* task;
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			taskPool.emplace_back();
+			task = &taskPool.back();
+			task->fn = [&fn, begin, end]() { fn(begin, end); };
+			task->pendingDeps = 0;
+			task->isDone = false;
+			task->group = &group;
+			pendingTasks++;
+		}
+		Push(task);
+	}
+	fn(0, std::min(grainSize, count));
+	group--;
+	while (group > 0) {
+		if (!RunOne()) std::this_thread::yield();
+	}
+}
+
+void TaskScheduler::Wait()
+{
+	while (pendingTasks > 0) {
+		if (!RunOne()) std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(poolMutex);
+	taskPool.clear();
+}
+
+void TaskScheduler::WorkerLoop(int queueIndex)
+{
+	tlsScheduler = this;
+	tlsQueue = queueIndex;
+	while (true) {
+		if (RunOne()) continue;
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wakeCondition.wait(lock, [this]() { return isQuit || readyTasks > 0; });
+		if (isQuit) return;
+	}
+}
+
+void TaskScheduler::Push(Task* task)
+{
+	Queue& queue = queues[tlsScheduler == this ? tlsQueue : 0];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+	readyTasks++;
+	// taking the lock orders this wake-up after any worker that is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wakeCondition.notify_one();
+}
+
+TaskScheduler::Task* TaskScheduler::Pop()
+{
+	int self = tlsScheduler == this ? tlsQueue : 0;
+	int queueNum = queues.size();
+	for (int i = 0; i < queueNum; i++) {
+		Queue& queue = queues[(self + i) % queueNum];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) continue;
+		Task* task;
+		// own queue: newest first (still hot in cache); others: steal the oldest
+		if (i == 0) {
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+		}
+		else {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+		readyTasks--;
+		return task;
+	}
+	return NULL;
+}
+
+bool TaskScheduler::RunOne()
+{
+	Task* task = Pop();
+	if (!task) return false;
+	Execute(task);
+	return true;
+}
+
+void TaskScheduler::Execute(Task* task)
+{
+	task->fn();
+	std::vector<Task*> next;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		task->isDone = true;
+		next.swap(task->successors);
+	}
+	for (Task* succ : next) {
+		if (--succ->pendingDeps == 0) Push(succ);
+	}
+	if (task->group) (*task->group)--;
+	pendingTasks--;
+}
@@ -25,6 +25,8 @@ AnimationPlayer* Window::currPlayer;
 // Camera Properties
 Camera* Window::Cam;
 
+TaskScheduler* Window::scheduler;
+
 // whether the model is just opened, control the camera mode
 const char* prevModel;
 
@@ -48,6 +50,7 @@ bool Window::initializeProgram() {
 }
 
 bool Window::initializeObjects() {
+    scheduler = new TaskScheduler();
     // Create skeleton
     testSkel = new Skeleton();
     wasp1Skel = new Skeleton();
@@ -60,11 +63,14 @@ bool Window::initializeObjects() {
     // Create skin
     wasp1Skin = new Skin(wasp1Skel);
     wasp1Skin->Load("assets/wasp1.skin");
+    wasp1Skin->scheduler = scheduler;
     currSkin = wasp1Skin;
     currSkin->Update();
     // Create animation
     waspRig = new AnimRig();
     waspRig->Load("assets/wasp2.skel", "assets/wasp2.skin");
+    waspRig->SetupFootIK("knee");
+    waspRig->skin->scheduler = scheduler;
     waspClip = new AnimationClip();
     waspClip->Load("assets/wasp2_walk.anim");
     waspPlayer = new AnimationPlayer(waspClip, waspRig);
@@ -142,20 +148,41 @@ void Window::resizeCallback(GLFWwindow* window, int width, int height) {
 }
 
 // update and draw functions
+// Queue a rig's update chain: clip evaluation -> skeleton -> skin
+static void scheduleRigUpdate(TaskScheduler* scheduler, AnimationPlayer* player) {
+    // should first update animation player to get root translation
+    TaskScheduler::TaskHandle clipTask = scheduler->AddTask([player]() { player->Update(); });
+    TaskScheduler::TaskHandle skelTask = scheduler->AddTask([player]() {
+        player->rig->UpdateSkeleton(player->rootTranslation);
+    }, { clipTask });
+    scheduler->AddTask([player]() { player->rig->UpdateSkin(); }, { skelTask });
+}
+
 void Window::idleCallback() {
     // Perform any updates as necessary.
     Cam->Update();
-    testSkel->Update(glm::mat4(1.0f));
-    wasp1Skel->Update(glm::mat4(1.0f));
-    dragonSkel->Update(glm::mat4(1.0f));
-    wasp1Skin->Update();
 
-    // should first update animation player to get root translation
-    waspPlayer->Update();
-    waspRig->Update(waspPlayer->rootTranslation);
+    // level of detail from each skin's size on screen, chosen before it is skinned
+    for (Skin* skin : { wasp1Skin, waspPlayer->rig->skin }) {
+        skin->SelectLOD(Cam->ProjectedSize(skin->GetBoundCenter(), skin->boundRadius));
+    }
+
+    // Skeletons and rigs are independent of each other, so they are updated as tasks that run
+    // on all cores while the main thread returns to the window; displayCallback waits for them
+    scheduler->AddTask([]() { testSkel->Update(glm::mat4(1.0f)); });
+    scheduler->AddTask([]() { dragonSkel->Update(glm::mat4(1.0f)); });
+    TaskScheduler::TaskHandle wasp1SkelTask = scheduler->AddTask([]() { wasp1Skel->Update(glm::mat4(1.0f)); });
+    scheduler->AddTask([]() { wasp1Skin->Update(); }, { wasp1SkelTask });
+    scheduleRigUpdate(scheduler, waspPlayer);
+}
+
+void Window::waitForUpdates() {
+    scheduler->Wait();
 }
 
 void Window::displayCallback(GLFWwindow* window, bool isDrawOriginalSkin, bool isDrawSkel, bool isDrawAttachedSkin, bool isPlayAnim) {
+    // Everything below reads the updated skeletons & skins and uploads them to GL
+    waitForUpdates();
     // Render the object.
     if (isDrawSkel) {
         currSkel->Draw(Cam->GetViewProjectMtx(), Window::shaderProgram->programID);
@@ -179,6 +206,7 @@ void Window::displayCallback(GLFWwindow* window, bool isDrawOriginalSkin, bool i
 
 // helper to reset the camera
 void Window::resetCamera() {
+    waitForUpdates();
     Cam->Reset();
     Cam->Aspect = float(Window::width) / float(Window::height);
     currSkel->root->ResetAll();
@@ -250,9 +278,11 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
 
 void Window::cleanUp() {
     // Deallcoate the objects.
+    delete scheduler;
     delete testSkel;
     delete wasp1Skel;
     delete dragonSkel;
+    delete Skeleton::boxMesh;
     delete wasp1Skin;
     delete waspRig;
     delete waspClip;
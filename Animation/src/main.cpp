@@ -78,15 +78,15 @@ void makeSliderBox(Joint* root) {
 
     float minX = root->JointDOF[0]->DOFmin;
     float maxX = root->JointDOF[0]->DOFmax;
-    ImGui::SliderFloat(("DOF_X (" + std::string(root->JointName) + ")").c_str(), &(root->JointDOF[0]->DOFvalue), minX, maxX);
+    ImGui::SliderFloat(("DOF_X (" + std::string(root->JointName) + ")").c_str(), root->JointDOF[0]->DOFvalue, minX, maxX);
 
     float minY = root->JointDOF[1]->DOFmin;
     float maxY = root->JointDOF[1]->DOFmax;
-    ImGui::SliderFloat(("DOF_Y (" + std::string(root->JointName) + ")").c_str(), &(root->JointDOF[1]->DOFvalue), minY, maxY);
+    ImGui::SliderFloat(("DOF_Y (" + std::string(root->JointName) + ")").c_str(), root->JointDOF[1]->DOFvalue, minY, maxY);
 
     float minZ = root->JointDOF[2]->DOFmin;
     float maxZ = root->JointDOF[2]->DOFmax;
-    ImGui::SliderFloat(("DOF_Z (" + std::string(root->JointName) + ")").c_str(), &(root->JointDOF[2]->DOFvalue), minZ, maxZ);
+    ImGui::SliderFloat(("DOF_Z (" + std::string(root->JointName) + ")").c_str(), root->JointDOF[2]->DOFvalue, minZ, maxZ);
 
     for (int i = 0; i < root->children.size(); i++) {
         makeSliderBox(root->children[i]);
@@ -204,6 +204,33 @@ int main(void) {
                     Window::currPlayer->playMode = "Walk back and forth";
                 }
 
+                // skinning cost
+                Skin* skin = Window::currPlayer->rig->skin;
+                const char* kernelNames[] = { "auto", "scalar", "reference", "AVX2" };
+                ImGui::Text("Skinning: %d / %d vertices, %.1f us (%s)", skin->skinnedVertexNum, skin->vertexNum, skin->skinMicroseconds,
+                    skin->isGPUSkinning ? "GPU" : kernelNames[SkinningKernel::Resolve(skin->kernelMode)]);
+                ImGui::Text("LOD %d: %d vertices, %d triangles", skin->lod, skin->lodVertexNum[skin->lod],
+                    (skin->lodIndexStart[skin->lod + 1] - skin->lodIndexStart[skin->lod]) / 3);
+                ImGui::SliderInt("Force LOD (-1: by distance)", &(skin->lodOverride), -1, skin->lodNum - 1);
+                if (skin->CanGPUSkin()) {
+                    ImGui::Checkbox("GPU Skinning", &(skin->isGPUSkinning));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Compare With CPU")) skin->CompareGPUSkinning();
+                    if (skin->gpuPositionError >= 0.0f) {
+                        ImGui::Text("GPU vs CPU: max position error %.2g, normal error %.2g", skin->gpuPositionError, skin->gpuNormalError);
+                    }
+                }
+
+                // foot placement
+                ImGui::Text("\nFoot IK Settings");
+                AnimRig* rig = Window::currPlayer->rig;
+                ImGui::Checkbox("Plant Feet On Ground", &(rig->isFootIK));
+                ImGui::SliderFloat("Ground Height", &(rig->groundHeight), -5.0f, 5.0f);
+                if (rig->isFootIK) {
+                    ImGui::Text("IK: %d iterations, error %.4f, %.1f us%s", rig->ik->stats.iterations,
+                        rig->ik->stats.error, rig->ik->stats.microseconds, rig->ik->stats.usedFallback ? " (FABRIK)" : "");
+                }
+
                 // Slider box for camera
                 ImGui::Text("\nCamera Settings");
                 ImGui::SliderFloat("Distance", &(Window::Cam->Distance), 1.0f, 100.0f);
@@ -0,0 +1,122 @@
+////////////////////////////////////////
+// CubeInstancingTest.cpp
+////////////////////////////////////////
+
+// Renders the walking wasp's joint boxes twice into an offscreen framebuffer: once through
+// Skeleton::Draw (one instanced call) and once with a drawCube call per joint, for a few frames
+// of the walk clip, and compares the pixels. Exits with 1 if the images differ by more than
+// rounding at box edges, or if nothing was drawn.
+//
+// Build from Animation/ and run from there (needs the assets & a GL context, see TestContext.h), e.g.
+//   g++ -O2 -std=c++17 -I include -I tests/compat -include MSVCCompat.h tests/CubeInstancingTest.cpp src/{AnimationClip,Channel,Keyframe,Skeleton,Joint,DOF,Tokenizer,FastMath,Cube,Shader,Camera}.cpp -lglfw -lGLEW -lGL -lpthread -o CubeInstancingTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\CubeInstancingTest.cpp src\AnimationClip.cpp ... lib\glfw3.lib lib\glew32s.lib opengl32.lib
+
+#include "TestContext.h"
+#include "AnimationClip.h"
+#include "Camera.h"
+#include "Shader.h"
+#include "Skeleton.h"
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+	const int IMAGE_SIZE = 256;
+
+	// Clear the framebuffer, draw & read it back as RGBA
+	template<typename DrawFunc>
+	std::vector<unsigned char> Render(DrawFunc draw)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		draw();
+		std::vector<unsigned char> pixels(4 * IMAGE_SIZE * IMAGE_SIZE);
+		glReadPixels(0, 0, IMAGE_SIZE, IMAGE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		return pixels;
+	}
+}
+
+int main()
+{
+	GLFWwindow* window = TestContext::Create();
+	if (!window) {
+		printf("no GL context\n");
+		return 1;
+	}
+	ShaderProgram* shaderProgram = new ShaderProgram("shaders/shader.glsl");
+	Skeleton* skeleton = new Skeleton();
+	AnimationClip* clip = new AnimationClip();
+	if (!shaderProgram->programID || !skeleton->Load("assets/wasp2.skel") || !clip->Load("assets/wasp2_walk.anim")) return 1;
+	clip->Precompute();
+	GLuint shader = shaderProgram->programID;
+
+	// offscreen color & depth, so the hidden window's size & format do not matter
+	GLuint FBO, colorBuffer, depthBuffer;
+	glGenFramebuffers(1, &FBO);
+	glGenRenderbuffers(1, &colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, IMAGE_SIZE, IMAGE_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMAGE_SIZE, IMAGE_SIZE);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("no offscreen framebuffer FAILED\n");
+		return 1;
+	}
+	glViewport(0, 0, IMAGE_SIZE, IMAGE_SIZE);
+	// same state as the viewer's setup_opengl_settings
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+	// the viewer's wasp camera, closer than the walking one since the root stays put here
+	Camera* camera = new Camera(2);
+	camera->Aspect = 1.0f;
+	camera->Update();
+
+	bool isPassed = true;
+	std::vector<float> poses(3 * skeleton->joints.size() + 3);
+	for (int frame = 0; frame < 4; frame++) {
+		clip->Evaluate(clip->tStart + (0.1f + 0.2f * frame) * (clip->tEnd - clip->tStart), poses);
+		skeleton->SetPose(poses.data() + 3);
+		skeleton->Update(glm::mat4(1.0f));
+
+		std::vector<unsigned char> instanced = Render([&] { skeleton->Draw(camera->GetViewProjectMtx(), shader); });
+		std::vector<unsigned char> perJoint = Render([&] {
+			for (Joint* joint : skeleton->joints) {
+				Skeleton::boxMesh->drawCube(joint->W * joint->boxMtx, camera->GetViewProjectMtx(), shader);
+			}
+		});
+
+		// the instanced path multiplies the matrices on the GPU, so a pixel right on a box edge
+		// may round the other way; a wrong or missing box changes far more than that
+		int numCovered = 0, numDifferent = 0, maxDifference = 0;
+		for (int p = 0; p < IMAGE_SIZE * IMAGE_SIZE; p++) {
+			int difference = 0;
+			for (int c = 0; c < 4; c++) difference = std::max(difference, abs(instanced[4 * p + c] - perJoint[4 * p + c]));
+			numCovered += perJoint[4 * p + 3] != 0;
+			numDifferent += difference > 2;
+			maxDifference = std::max(maxDifference, difference);
+		}
+		bool isOk = numCovered > IMAGE_SIZE * IMAGE_SIZE / 100 && numDifferent <= numCovered / 1000;
+		isPassed &= isOk;
+		printf("frame %d: %d joint boxes, %d pixels covered, %d differ (largest difference %d/255) %s\n",
+			frame, (int)skeleton->joints.size(), numCovered, numDifferent, maxDifference, isOk ? "" : "FAILED");
+	}
+	if (glGetError() != GL_NO_ERROR) {
+		printf("GL error FAILED\n");
+		isPassed = false;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	delete camera;
+	delete clip;
+	delete skeleton;
+	delete shaderProgram;
+	TestContext::Destroy(window);
+	return isPassed ? 0 : 1;
+}
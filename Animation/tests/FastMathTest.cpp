@@ -0,0 +1,91 @@
+////////////////////////////////////////
+// FastMathTest.cpp
+////////////////////////////////////////
+
+// Accuracy check & microbenchmark of FastMath against libm / glm. Exits with 1 if
+// an error bound documented in FastMath.h is exceeded; timings are only printed.
+//
+// Build from Animation/ (console program, no GL context needed), e.g.
+//   g++ -O2 -std=c++17 -I include tests/FastMathTest.cpp src/FastMath.cpp -o FastMathTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\FastMathTest.cpp src\FastMath.cpp
+
+#include "FastMath.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace {
+	const int N = 1 << 20;
+	const int REPEATS = 20;
+
+	template <typename Func>
+	double Milliseconds(Func func)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < REPEATS; r++) func();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	bool isPassed = true;
+
+	/** SinCos: absolute error <= 1e-7 (+ float rounding of the result) for |x| <= 8192 **/
+	std::vector<float> x(N), s(N), c(N);
+	for (float range : { 4.0f, 100.0f, 8192.0f }) {
+		std::uniform_real_distribution<float> angle(-range, range);
+		for (float& v : x) v = angle(rng);
+		x[0] = 0.0f;
+		x[1] = range;
+		FastMath::SinCos(x.data(), s.data(), c.data(), N - 3); // odd count, so the tail path runs too
+		double maxError = 0.0;
+		for (int i = 0; i < N - 3; i++) {
+			maxError = std::max(maxError, std::fabs(s[i] - std::sin((double)x[i])));
+			maxError = std::max(maxError, std::fabs(c[i] - std::cos((double)x[i])));
+		}
+		bool isOk = maxError <= 1e-7 + 6e-8; // bound + half an ulp of 1
+		isPassed &= isOk;
+		printf("SinCos   |x| <= %-6g max abs error %.3g %s\n", range, maxError, isOk ? "" : "FAILED");
+	}
+
+	/** Distance: sqrtps of the squared distance, so float rounding only **/
+	std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+	std::vector<glm::vec3> a(N), b(N);
+	std::vector<float> d(N);
+	for (int i = 0; i < N; i++) {
+		a[i] = glm::vec3(coord(rng), coord(rng), coord(rng));
+		b[i] = glm::vec3(coord(rng), coord(rng), coord(rng));
+	}
+	b[0] = a[0];
+	FastMath::Distance(a.data(), b.data(), d.data(), N - 3);
+	double maxRelError = 0.0;
+	for (int i = 0; i < N - 3; i++) {
+		double exact = glm::length(glm::dvec3(a[i]) - glm::dvec3(b[i]));
+		maxRelError = std::max(maxRelError, std::fabs(d[i] - exact) / std::max(exact, 1e-6));
+	}
+	bool isDistanceOk = maxRelError <= 1e-6 && d[0] == 0.0f;
+	isPassed &= isDistanceOk;
+	printf("Distance max rel error %.3g %s\n", maxRelError, isDistanceOk ? "" : "FAILED");
+
+	/** Timings, per call over N elements **/
+	std::uniform_real_distribution<float> angle(-3.2f, 3.2f);
+	for (float& v : x) v = angle(rng);
+	double fastSinCos = Milliseconds([&] { FastMath::SinCos(x.data(), s.data(), c.data(), N); });
+	double libmSinCos = Milliseconds([&] {
+		for (int i = 0; i < N; i++) {
+			s[i] = sinf(x[i]);
+			c[i] = cosf(x[i]);
+		}
+	});
+	double fastDistance = Milliseconds([&] { FastMath::Distance(a.data(), b.data(), d.data(), N); });
+	double glmDistance = Milliseconds([&] {
+		for (int i = 0; i < N; i++) d[i] = glm::length(a[i] - b[i]);
+	});
+	printf("SinCos   %7.3f ms, sinf + cosf %7.3f ms (%.2fx) for %d angles\n", fastSinCos, libmSinCos, libmSinCos / fastSinCos, N);
+	printf("Distance %7.3f ms, glm::length %7.3f ms (%.2fx) for %d pairs\n", fastDistance, glmDistance, glmDistance / fastDistance, N);
+
+	return isPassed ? 0 : 1;
+}
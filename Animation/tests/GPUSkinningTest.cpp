@@ -0,0 +1,56 @@
+////////////////////////////////////////
+// GPUSkinningTest.cpp
+////////////////////////////////////////
+
+// Skins the walking wasp on the GPU (transform feedback of the skinning vertex shader) and on
+// the CPU reference kernel through Skin::CompareGPUSkinning, for the bind pose, frames across
+// the walk clip and an exaggerated pose. Exits with 1 if any pose is over the tolerances.
+//
+// Build from Animation/ and run from there (needs the assets & a GL context, see TestContext.h), e.g.
+//   g++ -O2 -std=c++17 -I include -I tests/compat -include MSVCCompat.h tests/GPUSkinningTest.cpp src/{AnimRig,AnimationClip,Channel,Keyframe,Skin,MeshOptimizer,Skeleton,Joint,DOF,Tokenizer,FastMath,IKSolver,TaskScheduler,SkinningKernel,Cube,Shader}.cpp -lglfw -lGLEW -lGL -lpthread -o GPUSkinningTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\GPUSkinningTest.cpp src\AnimRig.cpp ... lib\glfw3.lib lib\glew32s.lib opengl32.lib
+
+#include "TestContext.h"
+#include "AnimRig.h"
+#include "AnimationClip.h"
+#include <cstdio>
+
+int main()
+{
+	GLFWwindow* window = TestContext::Create();
+	if (!window) {
+		printf("no GL context\n");
+		return 1;
+	}
+	AnimRig* rig = new AnimRig();
+	AnimationClip* clip = new AnimationClip();
+	if (!rig->Load("assets/wasp2.skel", "assets/wasp2.skin") || !clip->Load("assets/wasp2_walk.anim")) return 1;
+	clip->Precompute();
+	if (!rig->skin->CanGPUSkin()) {
+		printf("no GPU skinning for this skin or context FAILED\n");
+		return 1;
+	}
+	bool isPassed = true;
+
+	/** Bind pose, then frames across the clip (at different phases of the step) **/
+	rig->Update(glm::mat4(1.0f));
+	isPassed &= rig->skin->CompareGPUSkinning();
+	std::vector<float> poses(3 * rig->skeleton->joints.size() + 3);
+	for (int frame = 0; frame < 4; frame++) {
+		clip->Evaluate(clip->tStart + (0.1f + 0.2f * frame) * (clip->tEnd - clip->tStart), poses);
+		rig->skeleton->SetPose(poses.data() + 3);
+		rig->Update(glm::mat4(1.0f));
+		isPassed &= rig->skin->CompareGPUSkinning();
+	}
+
+	/** Every DOF bent away from the clip, so all joints & blends take part **/
+	for (int i = 0; i < rig->skeleton->DOFvalues.size(); i++) rig->skeleton->DOFvalues[i] += 0.3f * sinf(1.7f * i);
+	rig->Update(glm::mat4(1.0f));
+	isPassed &= rig->skin->CompareGPUSkinning();
+
+	printf(isPassed ? "GPU skinning matches the CPU\n" : "GPU skinning differs from the CPU FAILED\n");
+	delete clip;
+	delete rig;
+	TestContext::Destroy(window);
+	return isPassed ? 0 : 1;
+}
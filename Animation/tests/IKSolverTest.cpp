@@ -0,0 +1,226 @@
+////////////////////////////////////////
+// IKSolverTest.cpp
+////////////////////////////////////////
+
+// Foot IK on the walking wasp: checks that a warm-started chain still follows the animated
+// pose, then sweeps maxIterations with & without warm start over the walk clip and prints how
+// many solves converge. Then the FABRIK fallback must never leave the feet further off than the
+// stalled solve it started from, nor write NaNs for chains with coincident points. Last, a paused frame solved
+// again must keep the skeleton's generation, and the next frame must bump it once.
+// Exits with 1 if a check fails; the sweep is only printed.
+//
+// Build from Animation/ and run from there (needs the assets & a GL context, see TestContext.h), e.g.
+//   g++ -O2 -std=c++17 -I include -I tests/compat -include MSVCCompat.h tests/IKSolverTest.cpp src/{AnimRig,AnimationClip,Channel,Keyframe,Skin,MeshOptimizer,Skeleton,Joint,DOF,Tokenizer,FastMath,IKSolver,TaskScheduler,SkinningKernel,Cube,Shader}.cpp -lglfw -lGLEW -lGL -lpthread -o IKSolverTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\IKSolverTest.cpp src\AnimRig.cpp ... lib\glfw3.lib lib\glew32s.lib opengl32.lib
+
+#include "TestContext.h"
+#include "AnimRig.h"
+#include "AnimationClip.h"
+#include <cstdio>
+#include <random>
+
+namespace {
+	const float FRAME_TIME = 0.01f; // AnimationPlayer's default deltaT
+
+	struct SweepResult {
+		double iterations = 0.0;
+		double error = 0.0;
+		double microseconds = 0.0;
+		double drift = 0.0;      // largest DOF change IK made to the animated pose, mean over frames
+		int numSolves = 0;
+		int numConverged = 0;
+	};
+
+	// Largest difference between the skeleton's DOFs and pose
+	float MaxDifference(const Skeleton* skeleton, const std::vector<float>& pose)
+	{
+		float d = 0.0f;
+		for (int i = 0; i < pose.size(); i++) d = std::max(d, fabsf(skeleton->DOFvalues[i] - pose[i]));
+		return d;
+	}
+
+	bool IsFinite(const std::vector<float>& values)
+	{
+		for (float v : values) {
+			if (!std::isfinite(v)) return false;
+		}
+		return true;
+	}
+
+	// Play the clip once through foot IK, the way AnimationPlayer & AnimRig::UpdateSkeleton do
+	SweepResult PlayClip(AnimRig* rig, AnimationClip* clip)
+	{
+		SweepResult result;
+		std::vector<float> poses(3 * rig->skeleton->joints.size() + 3);
+		std::vector<float> animated;
+		int numFrames = 0;
+		for (float t = clip->tStart; t <= clip->tEnd; t += FRAME_TIME) {
+			clip->Evaluate(t, poses);
+			rig->skeleton->SetPose(poses.data() + 3);
+			animated = rig->skeleton->DOFvalues;
+			rig->UpdateSkeleton(glm::mat4(1.0f));
+			numFrames++;
+			result.drift += MaxDifference(rig->skeleton, animated);
+			bool isSolved = false;
+			for (const IKEffector& e : rig->ik->effectors) isSolved |= e.enabled;
+			if (!isSolved) continue; // no foot below the ground
+			result.numSolves++;
+			result.iterations += rig->ik->stats.iterations;
+			result.error += rig->ik->stats.error;
+			result.microseconds += rig->ik->stats.microseconds;
+			if (rig->ik->stats.error <= rig->ik->tolerance) result.numConverged++;
+		}
+		int n = std::max(result.numSolves, 1);
+		result.iterations /= n;
+		result.error /= n;
+		result.microseconds /= n;
+		result.drift /= std::max(numFrames, 1);
+		return result;
+	}
+}
+
+int main()
+{
+	GLFWwindow* window = TestContext::Create();
+	if (!window) {
+		printf("no GL context\n");
+		return 1;
+	}
+	AnimRig* rig = new AnimRig();
+	AnimationClip* clip = new AnimationClip();
+	if (!rig->Load("assets/wasp2.skel", "assets/wasp2.skin") || !clip->Load("assets/wasp2_walk.anim")) return 1;
+	clip->Precompute();
+	rig->SetupFootIK();
+	rig->isFootIK = true;
+	rig->ik->budgetMicroseconds = 1e6f; // compare by iterations, not by how fast this machine is
+	bool isPassed = true;
+
+	/** Targets on the animated feet: a warm start must land on the animated pose, with no iterations **/
+	std::vector<float> poses(3 * rig->skeleton->joints.size() + 3);
+	rig->groundHeight = 1e6f; // every foot is below it, so every effector is solved
+	for (int frame = 0; frame < 2; frame++) {
+		clip->Evaluate(clip->tStart + 0.25f * frame * (clip->tEnd - clip->tStart), poses);
+		rig->skeleton->SetPose(poses.data() + 3);
+		std::vector<float> animated = rig->skeleton->DOFvalues;
+		rig->skeleton->ComputePoseW(glm::mat4(1.0f));
+		for (int e = 0; e < rig->ik->effectors.size(); e++) {
+			rig->ik->effectors[e].enabled = true;
+			rig->ik->effectors[e].target = rig->ik->GetEffectorPosition(e);
+		}
+		rig->ik->Solve();
+		float drift = MaxDifference(rig->skeleton, animated);
+		bool isOk = rig->ik->stats.iterations == 0 && drift == 0.0f;
+		isPassed &= isOk;
+		printf("targets on the animated feet, frame %d: %d iterations, DOFs off the pose by %g %s\n",
+			frame, rig->ik->stats.iterations, drift, isOk ? "" : "FAILED");
+	}
+
+	/** Feet pushed up by the ground over the whole clip, warm vs cold start **/
+	// ground half way up the feet's range, so the lower steps are pulled up onto it
+	float lowest = 1e6f, highest = -1e6f;
+	for (float t = clip->tStart; t <= clip->tEnd; t += FRAME_TIME) {
+		clip->Evaluate(t, poses);
+		rig->skeleton->SetPose(poses.data() + 3);
+		rig->skeleton->ComputePoseW(glm::mat4(1.0f));
+		for (int e = 0; e < rig->ik->effectors.size(); e++) {
+			lowest = std::min(lowest, rig->ik->GetEffectorPosition(e).y);
+			highest = std::max(highest, rig->ik->GetEffectorPosition(e).y);
+		}
+	}
+	rig->groundHeight = lowest + 0.5f * (highest - lowest);
+
+	printf("\n%d feet, clip %.2f s at %g s a frame, tolerance %g\n", (int)rig->ik->effectors.size(),
+		clip->tEnd - clip->tStart, FRAME_TIME, rig->ik->tolerance);
+	printf("maxIterations  start  iterations  converged  mean error  us/solve  mean drift\n");
+	SweepResult warm30, cold30;
+	for (int maxIterations : { 1, 2, 4, 8, 16, 30 }) {
+		for (bool warmStart : { false, true }) {
+			rig->ik->maxIterations = maxIterations;
+			rig->ik->warmStart = warmStart;
+			PlayClip(rig, clip); // once to settle the warm start & caches
+			SweepResult r = PlayClip(rig, clip);
+			printf("%13d  %-5s  %10.2f  %8.1f%%  %10.5f  %8.1f  %10.4f\n", maxIterations, warmStart ? "warm" : "cold",
+				r.iterations, 100.0 * r.numConverged / std::max(r.numSolves, 1), r.error, r.microseconds, r.drift);
+			if (maxIterations == 30) (warmStart ? warm30 : cold30) = r;
+		}
+	}
+
+	// warm starting must not cost accuracy, nor let the chain wander off the animation
+	bool isWarmOk = warm30.numConverged >= cold30.numConverged && warm30.drift <= 1.5 * cold30.drift + 1e-4;
+	isPassed &= isWarmOk;
+	printf("warm start at 30 iterations: %d/%d converged (cold %d), drift %.4f (cold %.4f) %s\n", warm30.numConverged,
+		warm30.numSolves, cold30.numConverged, warm30.drift, cold30.drift, isWarmOk ? "" : "FAILED");
+
+	/** FABRIK fallback: each stalled solve again without it, from the same pose & targets **/
+	// feet effectors, then effectors right on the foot joint's pivot (a chain with coincident points)
+	IKSolver fallback(rig->skeleton);
+	IKSolver pivot(rig->skeleton);
+	for (const IKEffector& e : rig->ik->effectors) {
+		fallback.AddEffector(e.joint, e.localOffset, e.chainLength);
+		pivot.AddEffector(e.joint, glm::vec3(0.0f), e.chainLength);
+	}
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+	int numTrials = 0, numKept = 0, numWorse = 0, numNaN = 0;
+	for (IKSolver* solver : { &fallback, &pivot }) {
+		solver->warmStart = false;
+		solver->budgetMicroseconds = 1e6f;
+		for (int trial = 0; trial < 200; trial++) {
+			clip->Evaluate(clip->tStart + (clip->tEnd - clip->tStart) * trial / 200.0f, poses);
+			rig->skeleton->SetPose(poses.data() + 3);
+			rig->skeleton->ComputePoseW(glm::mat4(1.0f));
+			for (int e = 0; e < solver->effectors.size(); e++) {
+				IKEffector& eff = solver->effectors[e];
+				eff.enabled = true;
+				eff.target = solver->GetEffectorPosition(e) + glm::vec3(offset(random), offset(random), offset(random));
+				if (trial % 10 == 0) {
+					// right on the chain root's pivot
+					int root = eff.joint;
+					for (int k = 1; k < eff.chainLength && rig->skeleton->jointParent[root] >= 0; k++) root = rig->skeleton->jointParent[root];
+					eff.target = glm::vec3(rig->skeleton->poseW[root][3]);
+				}
+			}
+			solver->maxIterations = 5 + trial % 30; // stall at different distances
+			solver->useFallback = false;
+			solver->Solve();
+			float stalledError = solver->stats.error;
+			rig->skeleton->SetPose(poses.data() + 3);
+			solver->useFallback = true;
+			solver->Solve();
+			numTrials++;
+			numKept += solver->stats.usedFallback;
+			numWorse += solver->stats.error > stalledError;
+			numNaN += !IsFinite(rig->skeleton->DOFvalues);
+		}
+	}
+	bool isFallbackOk = numWorse == 0 && numNaN == 0;
+	isPassed &= isFallbackOk;
+	printf("FABRIK fallback: %d solves, %d kept, %d further off than without it, %d with NaN DOFs %s\n",
+		numTrials, numKept, numWorse, numNaN, isFallbackOk ? "" : "FAILED");
+
+	/** Paused on a frame with feet on the ground: the pose is solved again but must not count as new **/
+	clip->Evaluate(clip->tStart, poses);
+	int generation = 0;
+	bool isAnySolved = false;
+	for (int frame = 0; frame < 3; frame++) {
+		rig->skeleton->SetPose(poses.data() + 3);
+		rig->UpdateSkeleton(glm::mat4(1.0f));
+		if (frame == 0) generation = rig->skeleton->generation;
+		for (const IKEffector& e : rig->ik->effectors) isAnySolved |= e.enabled;
+	}
+	bool isPausedOk = isAnySolved && rig->skeleton->generation == generation;
+	isPassed &= isPausedOk;
+	printf("paused with foot IK: generation %d -> %d%s %s\n", generation, rig->skeleton->generation,
+		isAnySolved ? "" : " (no foot solved)", isPausedOk ? "" : "FAILED");
+	clip->Evaluate(clip->tStart + FRAME_TIME, poses);
+	rig->skeleton->SetPose(poses.data() + 3);
+	rig->UpdateSkeleton(glm::mat4(1.0f));
+	bool isNextOk = rig->skeleton->generation == generation + 1;
+	isPassed &= isNextOk;
+	printf("next frame with foot IK: generation %d -> %d %s\n", generation, rig->skeleton->generation, isNextOk ? "" : "FAILED");
+
+	delete clip;
+	delete rig;
+	TestContext::Destroy(window);
+	return isPassed ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+////////////////////////////////////////
+// MeshOptimizerTest.cpp
+////////////////////////////////////////
+
+// MeshOptimizer on a large skinned grid whose triangles & vertex ids are shuffled (the worst
+// exporter order): checks that the cache & fetch passes keep the triangle set, put vertices in
+// first-use order and bring ACMR down, then times the skinning loop before & after, both whole
+// and as the sparse reskin after one joint moves. Exits with 1 if a check fails; the timings
+// are only printed.
+//
+// Build from Animation/ (console program, no GL context needed), e.g.
+//   g++ -O2 -std=c++17 -I include tests/MeshOptimizerTest.cpp src/MeshOptimizer.cpp src/SkinningKernel.cpp -o MeshOptimizerTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\MeshOptimizerTest.cpp src\MeshOptimizer.cpp src\SkinningKernel.cpp
+
+#include "MeshOptimizer.h"
+#include "SkinningKernel.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+	const int GRID = 708;           // vertices per side, ~500k vertices
+	const int REGIONS = 8;          // joints per side, one per square region of the grid
+	const int INFLUENCES = 2;
+	const int RANGE_GAP = 32;       // Skin.cpp's SKIN_RANGE_GAP
+	const int REPEATS = 10;
+
+	struct Mesh {
+		std::vector<unsigned int> indices;
+		std::vector<glm::vec3> positions, normals;
+		std::vector<uint16_t> joints;   // one spare entry for the AVX2 gathers
+		std::vector<float> weights;
+		std::vector<glm::mat4> palette;
+		int VertexNum() const { return positions.size(); }
+	};
+
+	// Each vertex follows its region's joint, blended into the next region's along x
+	Mesh SkinnedGrid()
+	{
+		Mesh mesh;
+		int regionSize = (GRID + REGIONS - 1) / REGIONS;
+		for (int y = 0; y < GRID; y++) {
+			for (int x = 0; x < GRID; x++) {
+				mesh.positions.push_back(glm::vec3(x, y, 0.0f) / (float)GRID);
+				mesh.normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+				int rx = x / regionSize, ry = y / regionSize;
+				float t = (float)(x % regionSize) / regionSize;
+				mesh.joints.push_back(ry * REGIONS + rx);
+				mesh.joints.push_back(ry * REGIONS + std::min(rx + 1, REGIONS - 1));
+				mesh.weights.push_back(1.0f - 0.5f * t);
+				mesh.weights.push_back(0.5f * t);
+			}
+		}
+		mesh.joints.push_back(0);
+		for (int y = 0; y + 1 < GRID; y++) {
+			for (int x = 0; x + 1 < GRID; x++) {
+				unsigned int v = y * GRID + x;
+				mesh.indices.insert(mesh.indices.end(), { v, v + 1, v + GRID, v + 1, v + GRID + 1, v + GRID });
+			}
+		}
+		for (int j = 0; j < REGIONS * REGIONS; j++) mesh.palette.push_back(glm::rotate(0.01f * j, glm::vec3(0.0f, 1.0f, 0.0f)));
+		return mesh;
+	}
+
+	// Move the vertex attributes to the numbering remap (old -> new); the indices are left as they are
+	void RemapVertices(Mesh& mesh, const std::vector<int>& remap)
+	{
+		Mesh old = mesh;
+		for (int v = 0; v < old.VertexNum(); v++) {
+			mesh.positions[remap[v]] = old.positions[v];
+			mesh.normals[remap[v]] = old.normals[v];
+			for (int k = 0; k < INFLUENCES; k++) {
+				mesh.joints[remap[v] * INFLUENCES + k] = old.joints[v * INFLUENCES + k];
+				mesh.weights[remap[v] * INFLUENCES + k] = old.weights[v * INFLUENCES + k];
+			}
+		}
+	}
+
+	// Triangles in original vertex ids (through toOriginal), rotated to start at the smallest id & sorted
+	std::vector<std::array<unsigned int, 3>> TriangleSet(const Mesh& mesh, const std::vector<int>& toOriginal)
+	{
+		std::vector<std::array<unsigned int, 3>> set;
+		for (int t = 0; t + 2 < (int)mesh.indices.size(); t += 3) {
+			std::array<unsigned int, 3> tri;
+			for (int k = 0; k < 3; k++) tri[k] = toOriginal[mesh.indices[t + k]];
+			std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+			set.push_back(tri);
+		}
+		std::sort(set.begin(), set.end());
+		return set;
+	}
+
+	// The vertex ranges Skin re-skins when only joint moved (Skin::FindDirtyRanges)
+	std::vector<std::pair<int, int>> DirtyRanges(const Mesh& mesh, int joint)
+	{
+		std::vector<std::pair<int, int>> ranges;
+		for (int i = 0; i < mesh.VertexNum();) {
+			bool isDirty = false;
+			for (int k = 0; k < INFLUENCES; k++) {
+				isDirty |= mesh.joints[i * INFLUENCES + k] == joint && mesh.weights[i * INFLUENCES + k] > 0.0f;
+			}
+			if (!isDirty) {
+				i++;
+				continue;
+			}
+			if (!ranges.empty() && i - ranges.back().second <= RANGE_GAP) ranges.back().second = i + 1;
+			else ranges.push_back({ i, i + 1 });
+			i++;
+		}
+		return ranges;
+	}
+
+	struct Timing {
+		float acmr;
+		double fullMs;
+		double sparseMs;
+		int sparseVertexNum;
+		int sparseRangeNum;
+	};
+
+	Timing Measure(const Mesh& mesh)
+	{
+		Timing timing;
+		timing.acmr = MeshOptimizer::ComputeACMR(mesh.indices, mesh.VertexNum());
+		std::vector<SkinnedVertex> out(mesh.VertexNum());
+		auto skin = [&](int begin, int end) {
+			SkinningKernel::SkinRange(SkinningKernel::eAuto, begin, end, INFLUENCES, mesh.palette.data(), mesh.joints.data(),
+				mesh.weights.data(), mesh.positions.data(), mesh.normals.data(), out.data());
+		};
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < REPEATS; r++) skin(0, mesh.VertexNum());
+		timing.fullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+
+		// a joint in the middle of the grid
+		std::vector<std::pair<int, int>> ranges = DirtyRanges(mesh, (REGIONS / 2) * REGIONS + REGIONS / 2);
+		timing.sparseRangeNum = ranges.size();
+		timing.sparseVertexNum = 0;
+		for (auto& range : ranges) timing.sparseVertexNum += range.second - range.first;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < REPEATS; r++) {
+			for (auto& range : ranges) skin(range.first, range.second);
+		}
+		timing.sparseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+		return timing;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	bool isPassed = true;
+	Mesh mesh = SkinnedGrid();
+	int vertexNum = mesh.VertexNum();
+	int indexNum = mesh.indices.size();
+
+	/** Shuffle the triangles, then the vertex ids **/
+	std::vector<std::array<unsigned int, 3>> triangles(mesh.indices.size() / 3);
+	for (int t = 0; t < (int)triangles.size(); t++) triangles[t] = { mesh.indices[3 * t], mesh.indices[3 * t + 1], mesh.indices[3 * t + 2] };
+	std::shuffle(triangles.begin(), triangles.end(), rng);
+	for (int t = 0; t < (int)triangles.size(); t++) std::copy(triangles[t].begin(), triangles[t].end(), mesh.indices.begin() + 3 * t);
+	std::vector<int> shuffle(vertexNum);
+	for (int v = 0; v < vertexNum; v++) shuffle[v] = v;
+	std::shuffle(shuffle.begin(), shuffle.end(), rng);
+	for (unsigned int& v : mesh.indices) v = shuffle[v];
+	RemapVertices(mesh, shuffle);
+	std::vector<int> shuffledToOriginal(vertexNum);
+	for (int v = 0; v < vertexNum; v++) shuffledToOriginal[shuffle[v]] = v;
+	std::vector<std::array<unsigned int, 3>> triangleSet = TriangleSet(mesh, shuffledToOriginal);
+	Timing before = Measure(mesh);
+
+	/** Optimize as Skin::OptimizeMesh does (the fetch pass rewrites the indices itself) **/
+	auto start = std::chrono::steady_clock::now();
+	MeshOptimizer::OptimizeVertexCache(mesh.indices, vertexNum);
+	std::vector<int> remap = MeshOptimizer::OptimizeVertexFetch(mesh.indices, vertexNum);
+	double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	RemapVertices(mesh, remap);
+	Timing after = Measure(mesh);
+
+	/** Checks **/
+	std::vector<int> optimizedToOriginal(vertexNum);
+	for (int v = 0; v < vertexNum; v++) optimizedToOriginal[remap[v]] = shuffledToOriginal[v];
+	bool isSameTriangles = (int)mesh.indices.size() == indexNum && TriangleSet(mesh, optimizedToOriginal) == triangleSet;
+	unsigned int nextNew = 0;
+	bool isFirstUse = true;
+	for (unsigned int v : mesh.indices) {
+		if (v == nextNew) nextNew++;
+		else isFirstUse &= v < nextNew;
+	}
+	bool isCacheOk = after.acmr < 0.7f && after.acmr < before.acmr;
+	isPassed &= isSameTriangles && isFirstUse && isCacheOk;
+	printf("%d vertices, %d triangles, optimized in %.0f ms\n", vertexNum, (int)mesh.indices.size() / 3, optimizeMs);
+	printf("same triangles %s, first-use vertex order %s, ACMR %.3f -> %.3f %s\n", isSameTriangles ? "yes" : "no FAILED",
+		isFirstUse ? "yes" : "no FAILED", before.acmr, after.acmr, isCacheOk ? "" : "FAILED");
+
+	/** Skinning before & after **/
+	printf("full skinning loop   %8.3f ms -> %8.3f ms (%.2fx)\n", before.fullMs, after.fullMs, before.fullMs / after.fullMs);
+	printf("one joint's reskin   %8.3f ms -> %8.3f ms (%.2fx): %d -> %d vertices in %d -> %d ranges\n",
+		before.sparseMs, after.sparseMs, before.sparseMs / after.sparseMs, before.sparseVertexNum, after.sparseVertexNum,
+		before.sparseRangeNum, after.sparseRangeNum);
+
+	return isPassed ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+////////////////////////////////////////
+// SkinningKernelTest.cpp
+////////////////////////////////////////
+
+// Runs the skinning kernels on the same random rig & mesh: eAVX2 must match eReference bit
+// for bit, and eScalar must agree with both to float rounding. Exits with 1 if either check
+// fails; the kernel timings are only printed. Without AVX2 the bit-exact check is skipped.
+//
+// Build from Animation/ (console program, no GL context needed), e.g.
+//   g++ -O2 -std=c++17 -I include tests/SkinningKernelTest.cpp src/SkinningKernel.cpp -o SkinningKernelTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\SkinningKernelTest.cpp src\SkinningKernel.cpp
+
+#include "SkinningKernel.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+	const int VERTEX_NUM = 100003; // not a multiple of 8, so the AVX2 kernel's tail runs too
+	const int JOINT_NUM = 40;
+	const int REPEATS = 20;
+
+	struct Mesh {
+		int influenceNum;
+		std::vector<glm::mat4> palette;
+		std::vector<uint16_t> joints;   // one spare entry past the last vertex, as SkinRange requires
+		std::vector<float> weights;
+		std::vector<glm::vec3> positions, normals;
+	};
+
+	Mesh RandomMesh(int influenceNum, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_int_distribution<int> joint(0, JOINT_NUM - 1);
+		Mesh mesh;
+		mesh.influenceNum = influenceNum;
+		for (int j = 0; j < JOINT_NUM; j++) {
+			glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+			glm::mat4 M = glm::rotate(3.0f * unit(rng), axis) * glm::scale(glm::vec3(1.0f + 0.2f * unit(rng)));
+			M[3] = glm::vec4(10.0f * unit(rng), 10.0f * unit(rng), 10.0f * unit(rng), 1.0f);
+			mesh.palette.push_back(M);
+		}
+		mesh.joints.resize(VERTEX_NUM * influenceNum + 1);
+		mesh.weights.resize(VERTEX_NUM * influenceNum);
+		for (int i = 0; i < VERTEX_NUM; i++) {
+			// weights sum to 1, with unused slots at weight 0 & joint 0 like the loaded skins
+			int used = 1 + i % influenceNum;
+			float sum = 0.0f;
+			for (int k = 0; k < influenceNum; k++) {
+				float w = k < used ? 0.05f + std::fabs(unit(rng)) : 0.0f;
+				mesh.joints[i * influenceNum + k] = k < used ? joint(rng) : 0;
+				mesh.weights[i * influenceNum + k] = w;
+				sum += w;
+			}
+			for (int k = 0; k < influenceNum; k++) mesh.weights[i * influenceNum + k] /= sum;
+			mesh.positions.push_back(glm::vec3(unit(rng), unit(rng), unit(rng)) * 5.0f);
+			glm::vec3 n(unit(rng), unit(rng), unit(rng));
+			mesh.normals.push_back(i % 1000 == 0 ? glm::vec3(0.0f) : glm::normalize(n + glm::vec3(1e-3f)));
+		}
+		return mesh;
+	}
+
+	std::vector<SkinnedVertex> Skin(SkinningKernel::Mode mode, const Mesh& mesh, int begin = 0, int end = VERTEX_NUM)
+	{
+		std::vector<SkinnedVertex> out(VERTEX_NUM, SkinnedVertex{ glm::vec3(0.0f), 0 });
+		SkinningKernel::SkinRange(mode, begin, end, mesh.influenceNum, mesh.palette.data(), mesh.joints.data(),
+			mesh.weights.data(), mesh.positions.data(), mesh.normals.data(), out.data());
+		return out;
+	}
+
+	double Milliseconds(SkinningKernel::Mode mode, const Mesh& mesh)
+	{
+		std::vector<SkinnedVertex> out(VERTEX_NUM);
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < REPEATS; r++) {
+			SkinningKernel::SkinRange(mode, 0, VERTEX_NUM, mesh.influenceNum, mesh.palette.data(), mesh.joints.data(),
+				mesh.weights.data(), mesh.positions.data(), mesh.normals.data(), out.data());
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	bool isPassed = true;
+	bool hasAVX2 = SkinningKernel::HasAVX2();
+	if (!hasAVX2) printf("no AVX2 on this CPU: eAVX2 runs as eReference, skipping the bit-exact check\n");
+
+	for (int influenceNum : { 1, 2, 3, 4, 6 }) {
+		Mesh mesh = RandomMesh(influenceNum, rng);
+		std::vector<SkinnedVertex> reference = Skin(SkinningKernel::eReference, mesh);
+
+		/** eAVX2 against eReference, whole mesh & a range starting off the 8-vertex grid **/
+		if (hasAVX2) {
+			std::vector<SkinnedVertex> avx2 = Skin(SkinningKernel::eAVX2, mesh);
+			std::vector<SkinnedVertex> avx2Range = Skin(SkinningKernel::eAVX2, mesh, 5, VERTEX_NUM - 2);
+			std::vector<SkinnedVertex> referenceRange = Skin(SkinningKernel::eReference, mesh, 5, VERTEX_NUM - 2);
+			int mismatch = -1;
+			for (int i = 0; i < VERTEX_NUM && mismatch < 0; i++) {
+				if (memcmp(&avx2[i], &reference[i], sizeof(SkinnedVertex)) != 0
+					|| memcmp(&avx2Range[i], &referenceRange[i], sizeof(SkinnedVertex)) != 0) mismatch = i;
+			}
+			isPassed &= mismatch < 0;
+			if (mismatch < 0) printf("%d influences: eAVX2 == eReference bit for bit\n", influenceNum);
+			else printf("%d influences: eAVX2 != eReference at vertex %d FAILED\n", influenceNum, mismatch);
+		}
+
+		/** eScalar against eReference: float rounding, and at most 1 step of the packed normal **/
+		std::vector<SkinnedVertex> scalar = Skin(SkinningKernel::eScalar, mesh);
+		float maxPosition = 0.0f;
+		int maxNormalStep = 0;
+		for (int i = 0; i < VERTEX_NUM; i++) {
+			glm::vec3 d = glm::abs(scalar[i].position - reference[i].position);
+			maxPosition = std::max(maxPosition, std::max(d.x, std::max(d.y, d.z)));
+			for (int r = 0; r < 3; r++) {
+				int a = (int)(scalar[i].normal << (22 - 10 * r)) >> 22;
+				int b = (int)(reference[i].normal << (22 - 10 * r)) >> 22;
+				maxNormalStep = std::max(maxNormalStep, std::abs(a - b));
+			}
+		}
+		bool isScalarOk = maxPosition <= 1e-4f && maxNormalStep <= 1;
+		isPassed &= isScalarOk;
+		printf("%d influences: eScalar vs eReference max position error %g, normal %d step(s) %s\n",
+			influenceNum, maxPosition, maxNormalStep, isScalarOk ? "" : "FAILED");
+
+		/** Timings per call over the whole mesh **/
+		double scalarMs = Milliseconds(SkinningKernel::eScalar, mesh);
+		double referenceMs = Milliseconds(SkinningKernel::eReference, mesh);
+		double avx2Ms = Milliseconds(SkinningKernel::eAVX2, mesh);
+		printf("  eScalar %.3f ms, eReference %.3f ms, eAVX2 %.3f ms (%.2fx eScalar) for %d vertices\n",
+			scalarMs, referenceMs, avx2Ms, scalarMs / avx2Ms, VERTEX_NUM);
+	}
+
+	return isPassed ? 0 : 1;
+}
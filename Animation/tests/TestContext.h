@@ -0,0 +1,36 @@
+////////////////////////////////////////
+// TestContext.h
+////////////////////////////////////////
+
+#pragma once
+
+#include "core.h"
+
+// Loading a rig builds GL objects, so the tests that need one open a hidden window just for
+// its context. Any driver that offers GL 3.3 will do; on a machine without a GPU, Mesa's
+// software renderer (LIBGL_ALWAYS_SOFTWARE=1) runs them headless.
+namespace TestContext {
+	inline GLFWwindow* Create()
+	{
+		if (!glfwInit()) return NULL;
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "test", NULL, NULL);
+		if (!window) {
+			glfwTerminate();
+			return NULL;
+		}
+		glfwMakeContextCurrent(window);
+		if (glewInit() != GLEW_OK) {
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return NULL;
+		}
+		return window;
+	}
+
+	inline void Destroy(GLFWwindow* window)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+}
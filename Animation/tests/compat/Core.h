@@ -0,0 +1,10 @@
+////////////////////////////////////////
+// Core.h
+////////////////////////////////////////
+
+// Skin.h & Skeleton.h include "Core.h", the header is core.h: on a case sensitive file system
+// the tests' g++ build lines put this directory on the include path (-I tests/compat) to find it.
+
+#pragma once
+
+#include "core.h"
@@ -0,0 +1,21 @@
+////////////////////////////////////////
+// MSVCCompat.h
+////////////////////////////////////////
+
+// The MSVC library functions the sources call, for the tests' g++ build lines, which force this
+// header into every file (-include MSVCCompat.h). Nothing here is used by the MSVC build.
+
+#pragma once
+
+#ifndef _MSC_VER
+#include <cstring>
+
+// Joint.cpp copies into fixed size arrays, so the array's size is known as with MSVC's template overload
+template<size_t size>
+inline int strcpy_s(char (&dest)[size], const char* src)
+{
+	strncpy(dest, src, size - 1);
+	dest[size - 1] = '\0';
+	return 0;
+}
+#endif
@@ -1,6 +1,11 @@
 #pragma once
 #include "Spring.hpp"
+#include "ImplicitIntegrator.hpp"
+#include "XPBDSolver.hpp"
+#include "StrainLimiter.hpp"
 #include "Rigid.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
 
 class Cloth
 {
@@ -9,16 +14,60 @@ public:
     int numCols, numRows;
     int particleDensity = 5; // # particles per unit, control cloth pattern resolution
     const char* pinMode;
-    float structuralStiffness = 1000.0;
-    float shearStiffness = 50.0;
-    float bendingStiffness = 400.0;
-    float structuralDamping = 12.0;
-    float shearDamping = 0.6;
-    float bendingDamping = 5.0;
+    // Ks & Kd per spring type, shared by every spring of the type (edited live by the UI)
+    SpringParams structuralParams = { 1000.0, 12.0 };
+    SpringParams shearParams = { 50.0, 0.6 };
+    SpringParams bendingParams = { 400.0, 5.0 };
     vec3 clothPos;
-    std::vector<Particle*> particles;
-    std::vector<Spring*> springs;
-    std::vector<Particle*> trianglePs; // particles that make up of cloth triangles
+    Particles particles; // particle (row, col) is index row * numCols + col
+    SpringBatch structuralSprings = SpringBatch(&structuralParams);
+    SpringBatch shearSprings = SpringBatch(&shearParams);
+    SpringBatch bendingSprings = SpringBatch(&bendingParams);
+    std::vector<SpringBatch*> springBatches = { &structuralSprings, &shearSprings, &bendingSprings };
+    std::vector<int> triangles; // particle indices, 3 per cloth triangle, grouped by color (see colorElements)
+    std::vector<int> triangleColorStart; // triangles of color c: [triangleColorStart[c], triangleColorStart[c + 1])
+    // Force passes are split over this pool (serially if NULL); results are the same either way
+    ThreadPool* threadPool = NULL;
+    // Explicit (symplectic) Euler needs small steps; implicit Euler (see ImplicitIntegrator) and
+    // XPBD (see XPBDSolver, springs as constraints instead of forces) take large ones
+    enum SolverEnum {
+        SOLVER_EXPLICIT,
+        SOLVER_IMPLICIT,
+        SOLVER_XPBD,
+    };
+    SolverEnum solver = SOLVER_EXPLICIT;
+    ImplicitIntegrator implicitIntegrator;
+    XPBDSolver xpbdSolver;
+    // Caps the stretch of structural & shear springs after each step, plus tethers to the pinned particles
+    // (see StrainLimiter), so soft springs with few substeps do not sag out of shape
+    bool useStrainLimit = true;
+    StrainLimiter strainLimiter;
+    std::vector<SpringBatch*> limitedBatches = { &structuralSprings, &shearSprings };
+    // Sleeping: a tile of tileSize x tileSize particles whose kinetic energy & force residual stay below
+    // the thresholds for sleepFrames frames stops integrating until it is disturbed (see updateSleep);
+    // once every tile sleeps, isAsleep tells the caller to skip the substeps until wake
+    bool useSleeping = true;
+    int tileSize = 8;
+    double sleepEnergy = 1e-4; // largest kinetic energy 1/2 m v^2 of a particle, v averaged over the frame
+    double sleepResidual = 0.05; // largest net force on a particle, m dv / dt between frame averages
+    double wakeForce = 1.0; // change of force on a sleeping particle that wakes its tile (stiff springs
+                            // shift a lot as awake neighbors creep, so well above sleepResidual)
+    int sleepFrames = 30;
+    int numTileRows, numTileCols;
+    int numAwakeTiles = 0;
+    std::vector<int> tileOf; // tile of each particle
+    std::vector<char> isTileAsleep;
+    std::vector<char> isTileSettling; // fell asleep this frame, its rest forces are still to be taken
+    std::vector<int> tileCalmFrames; // frames in a row below the thresholds
+    std::vector<double> tileEnergy, tileResidual; // largest per particle over the frame
+    std::vector<vec3> framePosition, frameVelocity; // position at the frame start, mean velocity over the last
+    std::vector<vec3> restForce; // force on a sleeping particle when it fell asleep
+    std::vector<int> sleepingParticles; // held still during integrateMotion
+    // Take spring forces straight from the grid (see applyGridSpringForces) instead of the batches.
+    // Only square cloths qualify: init lays index (row, col) out as grid point (col, row).
+    bool useGridStencil = true;
+    std::vector<std::vector<vec3>> rowForces; // scratch of applyGridSpringForces, one per thread
+    std::vector<vec3> rowStiffness, rowDamping; // scratch of springTimeStep
 
     enum DrawModeEnum {
         DRAW_PARTICLES,
@@ -38,24 +87,27 @@ public:
         init();
     }
 
-    Particle* getParticle(int row, int col) { return particles[row * numCols + col]; }
+    int getIndex(int row, int col) { return row * numCols + col; }
 
     void PinParticle(int row, int col, vec3 offset)
     {
-        getParticle(row, col)->position = vec3(((double)col / particleDensity), (double)row / particleDensity, 0) + offset;
-        getParticle(row, col)->isFixed = true;
+        int i = getIndex(row, col);
+        particles.position[i] = vec3(((double)col / particleDensity), (double)row / particleDensity, 0) + offset;
+        particles.pin(i);
     }
 
     void UnPinParticle(int row, int col)
     {
-        getParticle(row, col)->isFixed = false;
+        particles.unpin(getIndex(row, col));
     }
 
     void dropCloth()
     {
         for (int i = 0; i < numCols; i++) {
-            if (particles[i]->isFixed) UnPinParticle(0, i);
+            if (particles.isPinned(i)) UnPinParticle(0, i);
         }
+        strainLimiter.buildTethers(particles);
+        wake();
     }
 
     void init()
@@ -63,13 +115,11 @@ public:
         /** Add particles **/
         for (int col = 0; col < numCols; col++) {
             for (int row = 0; row < numRows; row++) {
-                /** Create particle by position **/
-                Particle* p = new Particle(vec3((double)row / particleDensity, -((double)col / particleDensity), 0));
+                /** Add particle to cloth by position **/
+                int i = particles.add(vec3((double)row / particleDensity, -((double)col / particleDensity), 0));
                 /** Set texture coordinates **/
-                p->texCoord.x = (double)row / (numRows - 1);
-                p->texCoord.y = (double)col / (1 - numCols);
-                /** Add particle to cloth **/
-                particles.push_back(p);
+                particles.texCoord[i].x = (double)row / (numRows - 1);
+                particles.texCoord[i].y = (double)col / (1 - numCols);
             }
         }
         /** Add springs **/ 
@@ -77,56 +127,69 @@ public:
         for (int col = 0; col < numCols; col++) {
             for (int row = 0; row < numRows; row++) {
                 /** Structural springs **/
-                if (col < numCols - 1) springs.push_back(new Spring(getParticle(row, col), getParticle(row, col + 1), structuralStiffness, structuralDamping));
-                if (row < numRows - 1) springs.push_back(new Spring(getParticle(row, col), getParticle(row + 1, col), structuralStiffness, structuralDamping));
+                if (col < numCols - 1) structuralSprings.add(particles, getIndex(row, col), getIndex(row, col + 1));
+                if (row < numRows - 1) structuralSprings.add(particles, getIndex(row, col), getIndex(row + 1, col));
                 /** Shear springs **/
                 if (col < numCols - 1 && row < numRows - 1) {
-                    springs.push_back(new Spring(getParticle(row, col), getParticle(row + 1, col + 1), shearStiffness, shearDamping));
-                    springs.push_back(new Spring(getParticle(row, col + 1), getParticle(row + 1, col), shearStiffness, shearDamping));
+                    shearSprings.add(particles, getIndex(row, col), getIndex(row + 1, col + 1));
+                    shearSprings.add(particles, getIndex(row, col + 1), getIndex(row + 1, col));
                 }
                 /** Bending springs **/
-                if (col < numCols - 2) springs.push_back(new Spring(getParticle(row, col), getParticle(row, col + 2), bendingStiffness, bendingDamping));
-                if (row < numRows - 2) springs.push_back(new Spring(getParticle(row, col), getParticle(row + 2, col), bendingStiffness, bendingDamping));
+                if (col < numCols - 2) bendingSprings.add(particles, getIndex(row, col), getIndex(row, col + 2));
+                if (row < numRows - 2) bendingSprings.add(particles, getIndex(row, col), getIndex(row + 2, col));
             }
         }
+        /** Split into tiles that sleep on their own **/
+        initTiles();
         /** Set fixed particles according to pin mode **/
         updatePinMode();
         /** Add triangles **/
         for (int col = 0; col < numCols - 1; col++) {
             for (int row = 0; row < numRows - 1; row++) {
                 // Left upper triangle
-                trianglePs.push_back(getParticle(row, col + 1));
-                trianglePs.push_back(getParticle(row, col));
-                trianglePs.push_back(getParticle(row + 1, col));
+                triangles.push_back(getIndex(row, col + 1));
+                triangles.push_back(getIndex(row, col));
+                triangles.push_back(getIndex(row + 1, col));
                 // Right bottom triangle
-                trianglePs.push_back(getParticle(row + 1, col + 1));
-                trianglePs.push_back(getParticle(row, col + 1));
-                trianglePs.push_back(getParticle(row + 1, col));
+                triangles.push_back(getIndex(row + 1, col + 1));
+                triangles.push_back(getIndex(row, col + 1));
+                triangles.push_back(getIndex(row + 1, col));
             }
         }
+        /** Group springs & triangles into sets without shared particles, for parallel force passes **/
+        for (int i = 0; i < springBatches.size(); i++) {
+            springBatches[i]->colorSprings(particles.size());
+        }
+        std::vector<int> order = colorElements(triangles, 3, particles.size(), triangleColorStart);
+        std::vector<int> oldTriangles = triangles;
+        for (int i = 0; i < order.size(); i++) {
+            for (int k = 0; k < 3; k++) triangles[3 * i + k] = oldTriangles[3 * order[i] + k];
+        }
     }
 
     void updateNormal()
     {
+        std::vector<vec3>& position = particles.position;
+        std::vector<vec3>& normal = particles.normal;
         /** Reset particle's normal **/
         for (int i = 0; i < particles.size(); i++) {
-            particles[i]->normal.setAsZero();
+            normal[i].setAsZero();
         }
         /** Compute normal of each triangle **/
-        for (int i = 0; i < trianglePs.size() / 3; i++) { // 3 particles in each triangle
-            Particle* p1 = trianglePs[3 * i];
-            Particle* p2 = trianglePs[3 * i + 1];
-            Particle* p3 = trianglePs[3 * i + 2];
+        for (int i = 0; i < triangles.size() / 3; i++) { // 3 particles in each triangle
+            int p1 = triangles[3 * i];
+            int p2 = triangles[3 * i + 1];
+            int p3 = triangles[3 * i + 2];
             // Triangle normal
-            vec3 trgNormal = vec3::cross(p2->position - p1->position, p3->position - p1->position);
+            vec3 trgNormal = vec3::cross(position[p2] - position[p1], position[p3] - position[p1]);
             // Add triangle normal to particles it contains
-            p1->normal += trgNormal;
-            p2->normal += trgNormal;
-            p3->normal += trgNormal;
+            normal[p1] += trgNormal;
+            normal[p2] += trgNormal;
+            normal[p3] += trgNormal;
         }
         /** Normalize particle's normal **/
         for (int i = 0; i < particles.size(); i++) {
-            particles[i]->normal.normalize();
+            normal[i].normalize();
         }
     }
 
@@ -145,64 +208,350 @@ public:
                 PinParticle(0, i, { 1.0 - i * (2.0 / (numCols - 1)),0.0,0.0 });
             }
         }
+        strainLimiter.buildTethers(particles);
+        wake();
+    }
+
+    void initTiles()
+    {
+        numTileRows = (numRows + tileSize - 1) / tileSize;
+        numTileCols = (numCols + tileSize - 1) / tileSize;
+        tileOf.resize(particles.size());
+        for (int row = 0; row < numRows; row++) {
+            for (int col = 0; col < numCols; col++) {
+                tileOf[getIndex(row, col)] = (row / tileSize) * numTileCols + col / tileSize;
+            }
+        }
+        restForce.assign(particles.size(), vec3());
+        wake();
+    }
+
+    int numTiles() { return numTileRows * numTileCols; }
+
+    bool isAsleep() { return useSleeping && numAwakeTiles == 0; }
+
+    bool isParticleAsleep(int i) { return useSleeping && isTileAsleep[tileOf[i]]; }
+
+    // Every tile awake, e.g. after the user moved something
+    void wake()
+    {
+        isTileAsleep.assign(numTiles(), 0);
+        isTileSettling.assign(numTiles(), 0);
+        tileCalmFrames.assign(numTiles(), 0);
+        tileEnergy.assign(numTiles(), 0.0);
+        tileResidual.assign(numTiles(), 0.0);
+        framePosition = particles.position;
+        frameVelocity.assign(particles.size(), vec3());
+        numAwakeTiles = numTiles();
+    }
+
+    // Once per frame, after its substeps of frameT in all: calm tiles fall asleep, sleeping ones wake when
+    // their forces change (e.g. pulled by awake neighbors) or a neighboring tile still moves.
+    // Motion is measured over the whole frame: per substep, springs held by the strain limiter or resting
+    // contacts keep kicking particles that do not actually go anywhere.
+    void updateSleep(double frameT)
+    {
+        if (!useSleeping) {
+            if (numAwakeTiles < numTiles()) wake();
+            return;
+        }
+        if (frameT <= 0.0) return;
+        /** Largest kinetic energy & net force per tile (sleeping tiles have their force change already) **/
+        tileEnergy.assign(numTiles(), 0.0);
+        for (int i = 0; i < particles.size(); i++) {
+            if (particles.isPinned(i)) continue;
+            int tile = tileOf[i];
+            vec3 velocity = (particles.position[i] - framePosition[i]) / frameT;
+            double energy = 0.5 * particles.mass[i] * vec3::dot(velocity, velocity);
+            tileEnergy[tile] = std::max(tileEnergy[tile], energy);
+            if (!isTileAsleep[tile]) {
+                double netForce = particles.mass[i] * vec3::dist(velocity, frameVelocity[i]) / frameT;
+                tileResidual[tile] = std::max(tileResidual[tile], netForce);
+            }
+            frameVelocity[i] = velocity;
+        }
+        framePosition = particles.position;
+        /** Sleep or wake **/
+        numAwakeTiles = 0;
+        for (int t = 0; t < numTiles(); t++) {
+            if (isTileAsleep[t]) {
+                int row = t / numTileCols;
+                int col = t % numTileCols;
+                bool isNudged = tileResidual[t] > wakeForce;
+                for (int r = std::max(row - 1, 0); r <= std::min(row + 1, numTileRows - 1); r++) {
+                    for (int c = std::max(col - 1, 0); c <= std::min(col + 1, numTileCols - 1); c++) {
+                        if (tileEnergy[r * numTileCols + c] >= sleepEnergy) isNudged = true;
+                    }
+                }
+                if (isNudged) {
+                    isTileAsleep[t] = 0;
+                    tileCalmFrames[t] = 0;
+                }
+            }
+            else {
+                bool isCalm = tileEnergy[t] < sleepEnergy && tileResidual[t] < sleepResidual;
+                tileCalmFrames[t] = isCalm ? tileCalmFrames[t] + 1 : 0;
+                if (tileCalmFrames[t] >= sleepFrames) {
+                    isTileAsleep[t] = 1;
+                    isTileSettling[t] = 1;
+                }
+            }
+            if (!isTileAsleep[t]) numAwakeTiles++;
+        }
+        for (int i = 0; i < particles.size(); i++) {
+            if (isTileAsleep[tileOf[i]]) {
+                particles.velocity[i].setAsZero();
+                frameVelocity[i].setAsZero();
+            }
+        }
+        tileResidual.assign(numTiles(), 0.0);
     }
 
     void addGrabForce(vec3 grabForce)
     {
         for (int i = 0; i < particles.size(); i++)
         {
-            particles[i]->applyForce(grabForce);
+            particles.applyForce(i, grabForce);
         }
+        wake();
     }
 
     void computeForces(vec3 gravity, double fluidDensity, double dragCoeff, vec3 vFluid)
     {
         /** Particles **/
         for (int i = 0; i < particles.size(); i++) {
-            particles[i]->applyForce(gravity * particles[i]->mass);
-        }
-        /** Springs **/
-        for (int i = 0; i < springs.size(); i++) {
-            springs[i]->applyForce();
+            particles.force[i] += gravity * particles.mass[i];
         }
+        /** Springs (XPBD solves them as constraints instead) **/
+        if (solver != SOLVER_XPBD) applySpringForces();
         /** Aerodynamic force on triangles (then averagely to its particles) **/
-        for (int i = 0; i < trianglePs.size() / 3; i++) {
-            Particle* p1 = trianglePs[3 * i];
-            Particle* p2 = trianglePs[3 * i + 1];
-            Particle* p3 = trianglePs[3 * i + 2];
+        for (int c = 0; c + 1 < triangleColorStart.size(); c++) {
+            int first = triangleColorStart[c];
+            parallelFor(threadPool, triangleColorStart[c + 1] - first, [&](int begin, int end, int /*thread*/) {
+                applyAerodynamicForces(first + begin, first + end, fluidDensity, dragCoeff, vFluid);
+            }, 1024);
+        }
+    }
 
-            vec3 vSurface = (p1->velocity + p2->velocity + p3->velocity) / 3.0;
+    // Triangles [begin, end), which must not share particles with triangles other threads run
+    void applyAerodynamicForces(int begin, int end, double fluidDensity, double dragCoeff, vec3 vFluid)
+    {
+        std::vector<vec3>& position = particles.position;
+        std::vector<vec3>& velocity = particles.velocity;
+        for (int i = begin; i < end; i++) {
+            int p1 = triangles[3 * i];
+            int p2 = triangles[3 * i + 1];
+            int p3 = triangles[3 * i + 2];
+
+            vec3 vSurface = (velocity[p1] + velocity[p2] + velocity[p3]) / 3.0;
             vec3 relativeV = vSurface - vFluid;
             // Triangle normal
-            vec3 trgNormal = vec3::cross(p2->position - p1->position, p3->position - p1->position);
+            vec3 trgNormal = vec3::cross(position[p2] - position[p1], position[p3] - position[p1]);
             // Triangle area
-            double area0 = 0.5 * (vec3::cross(p2->position - p1->position, p3->position - p1->position)).length();
+            double area0 = 0.5 * trgNormal.length();
             // Cross-sectional area
             double area = area0 * vec3::dot(vec3::getNormalized(relativeV), trgNormal);
             // Aerodynamic force on triangle surface
             vec3 force = -0.5 * fluidDensity * relativeV.length() * relativeV.length() * dragCoeff * area * trgNormal;
             
             // Apply aerodynamic force averagely to particles of triangle
-            p1->applyForce(force / 3.0);
-            p2->applyForce(force / 3.0);
-            p3->applyForce(force / 3.0);
+            particles.force[p1] += force / 3.0;
+            particles.force[p2] += force / 3.0;
+            particles.force[p3] += force / 3.0;
+        }
+    }
+
+    void applySpringForces()
+    {
+        if (useGridStencil && numRows == numCols) {
+            applyGridSpringForces();
+        }
+        else {
+            for (int i = 0; i < springBatches.size(); i++) {
+                springBatches[i]->applyForces(particles, threadPool);
+            }
+        }
+    }
+
+    // The springs of init as fixed (row, col) offsets, rest lengths from the grid spacing
+    void applyGridSpringForces()
+    {
+        double spacing = 1.0 / particleDensity;
+        /** Structural springs **/
+        applyGridSprings(0, 1, spacing, structuralParams);
+        applyGridSprings(1, 0, spacing, structuralParams);
+        /** Shear springs **/
+        applyGridSprings(1, 1, sqrt(2.0) * spacing, shearParams);
+        applyGridSprings(1, -1, sqrt(2.0) * spacing, shearParams);
+        /** Bending springs **/
+        applyGridSprings(0, 2, 2.0 * spacing, bendingParams);
+        applyGridSprings(2, 0, 2.0 * spacing, bendingParams);
+    }
+
+    // Springs from every particle (row, col) to (row + dRow, col + dCol), swept a row at a time.
+    // Row r writes rows r & r + dRow, so rows split into blocks of dRow rows where a block only
+    // touches the next one: even blocks run in parallel, then odd blocks (all rows at once if dRow is 0).
+    void applyGridSprings(int dRow, int dCol, double restLen, SpringParams& params)
+    {
+        rowForces.resize(threadPool ? threadPool->size() : 1);
+        int numSweepRows = numRows - dRow;
+        int minChunk = 2048 / numCols + 1;
+        if (dRow == 0) {
+            parallelFor(threadPool, numSweepRows, [&](int begin, int end, int thread) {
+                for (int row = begin; row < end; row++) applyGridSpringRow(row, dRow, dCol, restLen, params, rowForces[thread]);
+            }, minChunk);
+            return;
+        }
+        int numBlocks = (numSweepRows + dRow - 1) / dRow;
+        for (int parity = 0; parity < 2; parity++) {
+            parallelFor(threadPool, (numBlocks - parity + 1) / 2, [&](int begin, int end, int thread) {
+                for (int block = 2 * begin + parity; block < 2 * end + parity && block < numBlocks; block += 2) {
+                    for (int row = block * dRow; row < (block + 1) * dRow && row < numSweepRows; row++) {
+                        applyGridSpringRow(row, dRow, dCol, restLen, params, rowForces[thread]);
+                    }
+                }
+            }, (minChunk + dRow - 1) / dRow);
+        }
+    }
+
+    // Each end of a row's springs is a contiguous run of particles, so the force loop reads
+    // neighbouring particles in lockstep and the two accumulation loops write without conflicts
+    void applyGridSpringRow(int row, int dRow, int dCol, double restLen, SpringParams& params, std::vector<vec3>& scratch)
+    {
+        int offset = dRow * numCols + dCol;
+        int colBegin = dCol < 0 ? -dCol : 0;
+        int colEnd = dCol > 0 ? numCols - dCol : numCols;
+        int n = colEnd - colBegin;
+        scratch.resize(n);
+        double Ks = params.Ks;
+        double Kd = params.Kd;
+        vec3* f1 = scratch.data();
+
+        int first = getIndex(row, colBegin);
+        const vec3* x1 = particles.position.data() + first;
+        const vec3* x2 = x1 + offset;
+        const vec3* v1 = particles.velocity.data() + first;
+        const vec3* v2 = v1 + offset;
+        for (int i = 0; i < n; i++) {
+            double dx = x2[i].x - x1[i].x;
+            double dy = x2[i].y - x1[i].y;
+            double dz = x2[i].z - x1[i].z;
+            double currLen = sqrt(dx * dx + dy * dy + dz * dz);
+            double invLen = currLen > 0.0 ? 1.0 / currLen : 0.0; // a collapsed spring has no direction, so no force
+            dx *= invLen; // direction of force on p1
+            dy *= invLen;
+            dz *= invLen;
+            double vCloseNeg = (v2[i].x - v1[i].x) * dx + (v2[i].y - v1[i].y) * dy + (v2[i].z - v1[i].z) * dz;
+            double f = Ks * (currLen - restLen) + Kd * vCloseNeg;
+            f1[i] = vec3(dx * f, dy * f, dz * f);
+        }
+        vec3* force1 = particles.force.data() + first;
+        vec3* force2 = force1 + offset;
+        for (int i = 0; i < n; i++) force1[i] += f1[i];
+        for (int i = 0; i < n; i++) force2[i] -= f1[i];
+    }
+
+    // Largest explicit Euler step the springs allow. Symplectic Euler on x'' = -lambda x - delta x' is stable
+    // while h^2 lambda + 2 h delta <= 4; lambda & delta are bounded per particle & axis by Gershgorin's
+    // theorem on the spring Jacobians (twice the absolute row sums over mass; the stiffness Jacobian
+    // Ks (u u^T + (1 - L0 / L) (I - u u^T)) includes the transverse term of stretched springs).
+    // Costs about one spring force pass, so callers may keep it for a frame.
+    double springTimeStep()
+    {
+        int n = particles.size();
+        rowStiffness.assign(n, vec3());
+        rowDamping.assign(n, vec3());
+        for (int b = 0; b < springBatches.size(); b++) {
+            SpringBatch* batch = springBatches[b];
+            double Ks = batch->params->Ks;
+            double Kd = batch->params->Kd;
+            for (int s = 0; s < batch->size(); s++) {
+                int p1 = batch->p1[s];
+                int p2 = batch->p2[s];
+                vec3 d = particles.position[p2] - particles.position[p1];
+                double len = d.length();
+                if (len == 0.0) continue;
+                vec3 u(fabs(d.x) / len, fabs(d.y) / len, fabs(d.z) / len);
+                double sum = u.x + u.y + u.z;
+                vec3 row(u.x * sum, u.y * sum, u.z * sum);
+                double transverse = std::max(0.0, 1.0 - batch->restLen[s] / len);
+                vec3 stiffness = row * (Ks * (1.0 - transverse)) + vec3(1.0, 1.0, 1.0) * (Ks * transverse);
+                rowStiffness[p1] += stiffness;
+                rowStiffness[p2] += stiffness;
+                rowDamping[p1] += row * Kd;
+                rowDamping[p2] += row * Kd;
+            }
+        }
+        double h = 1e9;
+        for (int i = 0; i < n; i++) {
+            if (particles.isPinned(i)) continue;
+            double k[3] = { rowStiffness[i].x, rowStiffness[i].y, rowStiffness[i].z };
+            double c[3] = { rowDamping[i].x, rowDamping[i].y, rowDamping[i].z };
+            for (int a = 0; a < 3; a++) {
+                double lambda = 2.0 * k[a] / particles.mass[i];
+                double delta = 2.0 * c[a] / particles.mass[i];
+                if (lambda > 0.0) h = std::min(h, (sqrt(delta * delta + 4.0 * lambda) - delta) / lambda);
+                else if (delta > 0.0) h = std::min(h, 2.0 / delta);
+            }
+        }
+        return h;
+    }
+
+    // CFL-style bound: no particle moves more than half the grid spacing per step. Cheap enough to check
+    // every substep, which catches fast transients (e.g. right after a pin moves) between springTimeStep calls.
+    double speedTimeStep()
+    {
+        double maxSpeed = 0.0;
+        for (int i = 0; i < particles.size(); i++) {
+            if (!particles.isPinned(i)) maxSpeed = std::max(maxSpeed, particles.velocity[i].length());
         }
+        return maxSpeed > 0.0 ? 0.5 / particleDensity / maxSpeed : 1e9;
     }
 
     void integrateMotion(double deltaT)
     {
-        for (int i = 0; i < particles.size(); i++) particles[i]->integrateMotion(deltaT);
+        if (useSleeping) holdSleepingParticles();
+        if (solver == SOLVER_IMPLICIT) implicitIntegrator.step(particles, springBatches, deltaT, threadPool);
+        else if (solver == SOLVER_XPBD) xpbdSolver.step(particles, springBatches, deltaT, threadPool);
+        else particles.integrateMotion(deltaT);
+        if (useStrainLimit) strainLimiter.apply(particles, limitedBatches, threadPool);
+        for (int k = 0; k < sleepingParticles.size(); k++) {
+            int i = sleepingParticles[k];
+            particles.invMass[i] = 1.0 / particles.mass[i];
+        }
+        sleepingParticles.clear();
+    }
+
+    // Gives sleeping particles invMass 0 for the step, so every solver leaves them be like pinned ones,
+    // and records how far their forces moved from those they fell asleep with. XPBD's springs are no
+    // forces, so there sleeping tiles only wake from their neighbors' motion.
+    void holdSleepingParticles()
+    {
+        for (int i = 0; i < particles.size(); i++) {
+            int tile = tileOf[i];
+            if (!isTileAsleep[tile] || particles.isPinned(i)) continue;
+            if (isTileSettling[tile]) restForce[i] = particles.force[i];
+            tileResidual[tile] = std::max(tileResidual[tile], vec3::dist(particles.force[i], restForce[i]));
+            particles.invMass[i] = 0.0;
+            particles.force[i].setAsZero();
+            sleepingParticles.push_back(i);
+        }
+        isTileSettling.assign(numTiles(), 0);
     }
 
     void collisionResponse(Ground* ground, Sphere* sphere)
     {
         for (int i = 0; i < particles.size(); i++)
         {
+            if (isParticleAsleep(i)) continue;
             /** Ground collision **/
-            vec3 pWorldPos = clothPos + particles[i]->position;
-            if (pWorldPos.y < ground->position.y) {
-                particles[i]->position.y = ground->position.y - clothPos.y + 0.01;
-                particles[i]->velocity *= ground->restitution;
+            // tested against the surface particles are put back on, so resting ones stay in contact
+            vec3 pWorldPos = clothPos + particles.position[i];
+            double groundHeight = ground->position.y + 0.01;
+            if (pWorldPos.y < groundHeight) {
+                particles.position[i].y = groundHeight - clothPos.y;
+                stopAgainstContact(i, vec3(0.0, 1.0, 0.0));
+                particles.velocity[i] *= ground->restitution;
             }
 
             /** Sphere collision **/
@@ -211,12 +560,20 @@ public:
             double collisionDist = sphere->radius * 1.05; // 5% redundancy
             if (dist < collisionDist) {
                 center2Particel.normalize();
-                particles[i]->position = sphere->center + collisionDist * center2Particel - clothPos;
-                particles[i]->velocity *= sphere->restitution;
+                particles.position[i] = sphere->center + collisionDist * center2Particel - clothPos;
+                stopAgainstContact(i, center2Particel);
+                particles.velocity[i] *= sphere->restitution;
             }
         }
     }
 
+    // Drops the part of the velocity going into the collider, else resting particles keep falling back
+    void stopAgainstContact(int i, vec3 normal)
+    {
+        double vInto = vec3::dot(particles.velocity[i], normal);
+        if (vInto < 0.0) particles.velocity[i] -= normal * vInto;
+    }
+
     void transform(const char* trsfInstruction, float clothMoveSpeed)
     {
         glm::mat4 T;
@@ -246,15 +603,16 @@ public:
         }
         glm::vec4 pos;
         for (int i = 0; i < particles.size(); i++) {
-            pos = { particles[i]->position.x,  particles[i]->position.y,  particles[i]->position.z, 1.0f };
+            pos = { particles.position[i].x,  particles.position[i].y,  particles.position[i].z, 1.0f };
             pos = T * pos;
-            particles[i]->position = vec3(pos.x, pos.y, pos.z);
+            particles.position[i] = vec3(pos.x, pos.y, pos.z);
         }
+        wake();
     }
 
     void reset()
     {
-        for (int i = 0; i < particles.size(); i++) { particles[i]->reset(); }
+        particles.reset();
         updatePinMode();
     }
 };
@@ -0,0 +1,268 @@
+#pragma once
+#include "Cloth.hpp"
+#include "TripleBuffer.hpp"
+#include <chrono>
+
+// What the render thread sees of the cloth: one per simulated frame
+struct ClothSnapshot
+{
+    std::vector<glm::vec3> position; // per particle
+    std::vector<glm::vec3> normal;
+    int numSteps = 0; // substeps of the last frame
+    double stepT = 0.0; // their mean length
+    double substepsPerSecond = 0.0; // simulation throughput, smoothed over frames
+    double wallPerSimSecond = 0.0; // ms of solver time per simulated second, smoothed over frames
+    int numAwakeTiles = 0;
+    int numTiles = 0;
+    int numTethers = 0;
+    int cgIterations = 0; // implicit Euler
+    double maxStrain = 0.0; // XPBD
+};
+
+// Everything the control panel edits, sent whole to the simulation thread when any of it changes
+struct ClothSettings
+{
+    bool isPaused = false;
+    bool isAdaptiveStep = true;
+    float timeScale = 18.0f; // 18 matches the fixed 0.3 s per frame at 60 FPS
+    int largeStepsPerFrame = 2; // implicit Euler / XPBD steps per frame
+    SpringParams structuralParams, shearParams, bendingParams;
+    bool useGridStencil;
+    bool isParallelForces = true;
+    bool useStrainLimit;
+    double maxStretch;
+    bool useTethers;
+    bool useSleeping;
+    Cloth::SolverEnum solver;
+    int xpbdIterations;
+    XPBDSolver::IterationEnum xpbdIteration;
+    bool useChebyshev;
+    float orbRestitution, groundRestitution;
+    vec3 vWind;
+};
+
+// Runs the cloth on its own thread, simRate frames per second, so a slow physics frame no longer holds
+// up the UI & drawing. Once started, no other thread touches the cloth or the colliders' restitution:
+// edits go through post as commands, run on the simulation thread between frames, and each frame is
+// published as a ClothSnapshot through snapshots (the render thread is its only reader).
+class ClothSimulator
+{
+public:
+    Cloth* cloth;
+    Ground* ground;
+    Sphere* orb;
+    ThreadPool* threadPool; // used by the cloth's force passes while isParallelForces
+    TripleBuffer<ClothSnapshot> snapshots;
+    double simRate = 60.0; // frames per second, when physics keeps up
+    int simFreq = 30; // steps per frame without adaptive stepping, gravity should be divided by this
+    double deltaT = 0.01;
+    // Adaptive stepping: each frame simulates timeScale times its (capped) duration, and explicit Euler takes
+    // the fewest substeps that stay stable (Cloth::springTimeStep & speedTimeStep); otherwise simFreq * deltaT
+    // per frame
+    double stepSafety = 0.9; // fraction of the stable step actually taken
+    double maxFrameTime = 1.0 / 20; // longer frames are simulated as this long, instead of catching up
+    int maxSubsteps = 200; // beyond this the simulation falls behind rather than stepping unstably
+    vec3 gravity;
+    double airDensity = 1.255;
+    double airDragCoeff = 1.28;
+
+    ClothSimulator(Cloth* clothArg, Ground* groundArg, Sphere* orbArg, ThreadPool* threadPoolArg)
+    {
+        cloth = clothArg;
+        ground = groundArg;
+        orb = orbArg;
+        threadPool = threadPoolArg;
+        gravity = vec3(0.0, -9.8 / simFreq, 0.0);
+        settings = getSettings();
+        lastOrbCenter = orb->center;
+        lastGroundPos = ground->position;
+    }
+
+    ~ClothSimulator() { stop(); }
+
+    // The cloth's & colliders' own settings, to start from; only safe before start
+    ClothSettings getSettings()
+    {
+        ClothSettings s = settings;
+        s.structuralParams = cloth->structuralParams;
+        s.shearParams = cloth->shearParams;
+        s.bendingParams = cloth->bendingParams;
+        s.useGridStencil = cloth->useGridStencil;
+        s.useStrainLimit = cloth->useStrainLimit;
+        s.maxStretch = cloth->strainLimiter.maxStretch;
+        s.useTethers = cloth->strainLimiter.useTethers;
+        s.useSleeping = cloth->useSleeping;
+        s.solver = cloth->solver;
+        s.xpbdIterations = cloth->xpbdSolver.numIterations;
+        s.xpbdIteration = cloth->xpbdSolver.iteration;
+        s.useChebyshev = cloth->xpbdSolver.useChebyshev;
+        s.orbRestitution = orb->restitution;
+        s.groundRestitution = ground->restitution;
+        return s;
+    }
+
+    void start(const ClothSettings& settingsArg)
+    {
+        applySettings(settingsArg);
+        publishSnapshot();
+        snapshots.update();
+        isRunning = true;
+        thread = std::thread(&ClothSimulator::run, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!isRunning) return;
+            isRunning = false;
+        }
+        commandPosted.notify_one();
+        thread.join();
+    }
+
+    // Run command on the simulation thread before its next frame
+    void post(std::function<void()> command)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.push_back(command);
+        }
+        commandPosted.notify_one();
+    }
+
+    void post(const ClothSettings& settingsArg)
+    {
+        ClothSettings s = settingsArg;
+        post([this, s] { applySettings(s); });
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    ClothSettings settings;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable commandPosted;
+    std::vector<std::function<void()>> commands, runningCommands;
+    bool isRunning = false;
+    int lastNumSteps = 0;
+    double lastStepT = 0.0;
+    double substepsPerSecond = 0.0;
+    double wallPerSimSecond = 0.0;
+    vec3 lastOrbCenter, lastGroundPos;
+
+    void run()
+    {
+        Clock::time_point frameStart = Clock::now();
+        while (true) {
+            /** Commands posted since the last frame **/
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!isRunning) return;
+                runningCommands.swap(commands);
+            }
+            bool isChanged = !runningCommands.empty();
+            for (int i = 0; i < runningCommands.size(); i++) runningCommands[i]();
+            runningCommands.clear();
+            /** Frame, at least a period long like a rendered one (commands may start it early) **/
+            Clock::time_point now = Clock::now();
+            double frameTime = std::max(std::chrono::duration<double>(now - frameStart).count(), 1.0 / simRate);
+            frameStart = now;
+            if (simulateFrame(frameTime)) isChanged = true;
+            if (isChanged) publishSnapshot();
+            /** Wait for the next frame; while idle, a command starts one right away **/
+            bool isIdle = settings.isPaused || cloth->isAsleep();
+            std::chrono::duration<double> period(1.0 / simRate);
+            std::unique_lock<std::mutex> lock(mutex);
+            commandPosted.wait_until(lock, frameStart + std::chrono::duration_cast<Clock::duration>(period), [&] {
+                return !isRunning || (isIdle && !commands.empty());
+            });
+        }
+    }
+
+    // Returns false if there is nothing new to publish
+    bool simulateFrame(double frameTime)
+    {
+        if (settings.isPaused) return false;
+        if (orb->center != lastOrbCenter || ground->position != lastGroundPos) cloth->wake();
+        lastOrbCenter = orb->center;
+        lastGroundPos = ground->position;
+        if (cloth->isAsleep()) {
+            bool wasStepping = lastNumSteps > 0;
+            lastNumSteps = 0;
+            return wasStepping; // once more, for the stats
+        }
+        double frameSimT = simFreq * deltaT;
+        if (settings.isAdaptiveStep) frameSimT = settings.timeScale * std::min(frameTime, maxFrameTime);
+        double stepT = frameSimT / (cloth->solver == Cloth::SOLVER_EXPLICIT ? simFreq : settings.largeStepsPerFrame);
+        bool isStepAdaptive = settings.isAdaptiveStep && cloth->solver == Cloth::SOLVER_EXPLICIT;
+        double springT = isStepAdaptive ? stepSafety * cloth->springTimeStep() : 0.0;
+        int numSteps = 0;
+        double simT = 0.0;
+        Clock::time_point simStart = Clock::now();
+        while (simT < frameSimT - 1e-9 && (!isStepAdaptive || numSteps < maxSubsteps)) {
+            if (isStepAdaptive) {
+                // the fewest equal steps over the rest of the frame that stay stable
+                double stableT = std::min(springT, stepSafety * cloth->speedTimeStep());
+                double restT = frameSimT - simT;
+                stepT = restT / ceil(restT / stableT);
+            }
+            cloth->computeForces(gravity, airDensity, airDragCoeff, settings.vWind);
+            cloth->integrateMotion(stepT);
+            cloth->collisionResponse(ground, orb);
+            simT += stepT;
+            numSteps++;
+        }
+        lastNumSteps = numSteps;
+        lastStepT = numSteps > 0 ? simT / numSteps : 0.0;
+        double simTime = std::chrono::duration<double>(Clock::now() - simStart).count();
+        if (simTime > 0.0) substepsPerSecond += 0.05 * (numSteps / simTime - substepsPerSecond);
+        if (simT > 0.0) wallPerSimSecond += 0.05 * (1000.0 * simTime / simT - wallPerSimSecond);
+        cloth->updateSleep(simT);
+        return numSteps > 0;
+    }
+
+    void applySettings(const ClothSettings& s)
+    {
+        settings = s;
+        cloth->structuralParams = s.structuralParams;
+        cloth->shearParams = s.shearParams;
+        cloth->bendingParams = s.bendingParams;
+        cloth->useGridStencil = s.useGridStencil;
+        cloth->threadPool = s.isParallelForces ? threadPool : NULL;
+        cloth->useStrainLimit = s.useStrainLimit;
+        cloth->strainLimiter.maxStretch = s.maxStretch;
+        cloth->strainLimiter.useTethers = s.useTethers;
+        cloth->useSleeping = s.useSleeping;
+        cloth->solver = s.solver;
+        cloth->xpbdSolver.numIterations = s.xpbdIterations;
+        cloth->xpbdSolver.iteration = s.xpbdIteration;
+        cloth->xpbdSolver.useChebyshev = s.useChebyshev;
+        orb->restitution = s.orbRestitution;
+        ground->restitution = s.groundRestitution;
+        cloth->wake(); // any edit may move the cloth
+    }
+
+    void publishSnapshot()
+    {
+        cloth->updateNormal();
+        ClothSnapshot& snapshot = snapshots.back();
+        int n = cloth->particles.size();
+        snapshot.position.resize(n);
+        snapshot.normal.resize(n);
+        for (int i = 0; i < n; i++) {
+            snapshot.position[i] = cloth->particles.getPosition(i);
+            snapshot.normal[i] = cloth->particles.getNormal(i);
+        }
+        snapshot.numSteps = lastNumSteps;
+        snapshot.stepT = lastStepT;
+        snapshot.substepsPerSecond = substepsPerSecond;
+        snapshot.wallPerSimSecond = wallPerSimSecond;
+        snapshot.numAwakeTiles = cloth->useSleeping ? cloth->numAwakeTiles : cloth->numTiles();
+        snapshot.numTiles = cloth->numTiles();
+        snapshot.numTethers = cloth->strainLimiter.numTethers();
+        snapshot.cgIterations = cloth->implicitIntegrator.iterations;
+        snapshot.maxStrain = cloth->xpbdSolver.maxStrain;
+        snapshots.publish();
+    }
+};
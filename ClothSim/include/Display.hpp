@@ -1,5 +1,5 @@
 #pragma once
-#include "Cloth.hpp"
+#include "ClothSimulator.hpp"
 #include "Program.hpp"
 #include "stb_image.h"
 
@@ -52,7 +52,8 @@ Camera camera;
 class ClothRenderer
 {
 public:
-    Cloth* cloth;
+    Cloth* cloth; // only its layout (triangles, texture coordinates) & draw mode are read
+    TripleBuffer<ClothSnapshot>* snapshots; // positions & normals, this thread being the reader
     int numParticles; // # particles in all triangles
 
     GLuint programID;
@@ -70,20 +71,21 @@ public:
     // Texture
     GLuint texID;
 
-    ClothRenderer(Cloth* clothArg, const char* clothTexFilename)
+    ClothRenderer(Cloth* clothArg, TripleBuffer<ClothSnapshot>* snapshotsArg, const char* clothTexFilename)
     {
         cloth = clothArg;
-        numParticles = cloth->trianglePs.size();
+        snapshots = snapshotsArg;
+        numParticles = cloth->triangles.size();
         if (numParticles <= 0) std::cout << "ERROR::ClothRenderer : No particle exists." << std::endl;
 
         vboPos = new glm::vec3[numParticles];
         vboNor = new glm::vec3[numParticles];
         vboTex = new glm::vec2[numParticles];
         for (int i = 0; i < numParticles; i++) {
-            Particle* p = cloth->trianglePs[i];
-            vboPos[i] = glm::vec3(p->position.x, p->position.y, p->position.z);
-            vboNor[i] = glm::vec3(p->normal.x, p->normal.y, p->normal.z);
-            vboTex[i] = glm::vec2(p->texCoord.x, p->texCoord.y);
+            int p = cloth->triangles[i];
+            vboPos[i] = cloth->particles.getPosition(p);
+            vboNor[i] = cloth->particles.getNormal(p);
+            vboTex[i] = cloth->particles.getTexCoord(p);
         }
 
         /** Build shader program **/
@@ -180,10 +182,12 @@ public:
 
     void Update()
     {
+        snapshots->update();
+        ClothSnapshot& snapshot = snapshots->front();
         for (int i = 0; i < numParticles; i++) {
-            Particle* p = cloth->trianglePs[i];
-            vboPos[i] = glm::vec3(p->position.x, p->position.y, p->position.z);
-            vboNor[i] = glm::vec3(p->normal.x, p->normal.y, p->normal.z);
+            int p = cloth->triangles[i];
+            vboPos[i] = snapshot.position[p];
+            vboNor[i] = snapshot.normal[p];
         }
 
         glUseProgram(programID);
@@ -236,7 +240,8 @@ public:
 class SpringRenderer
 {
 public:
-    std::vector<Spring*> springs;
+    Particles* particles;
+    std::vector<int> lineIndices; // particle index of each line end, 2 per spring
     int numSprings;
 
     GLuint programID;
@@ -248,22 +253,24 @@ public:
     glm::vec3* vboNor; // Normal
     glm::vec4 uniSpringColor;
 
-    SpringRenderer(std::vector<Spring*> springsArg, glm::vec4 springColorArg, glm::vec3 modelMtxArg)
+    SpringRenderer(Particles* particlesArg, std::vector<SpringBatch*> springBatches, glm::vec4 springColorArg, glm::vec3 modelMtxArg)
     {
-        springs = springsArg;
-        numSprings = springs.size();
+        particles = particlesArg;
+        for (int b = 0; b < springBatches.size(); b++) {
+            for (int i = 0; i < springBatches[b]->size(); i++) {
+                lineIndices.push_back(springBatches[b]->p1[i]);
+                lineIndices.push_back(springBatches[b]->p2[i]);
+            }
+        }
+        numSprings = lineIndices.size() / 2;
         if (numSprings <= 0) std::cout << "ERROR::SpringRenderer : No spring exists." << std::endl;
         uniSpringColor = springColorArg;
 
         vboPos = new glm::vec3[numSprings * 2];
         vboNor = new glm::vec3[numSprings * 2];
-        for (int i = 0; i < numSprings; i++) {
-            Particle* p1 = springs[i]->p1;
-            Particle* p2 = springs[i]->p2;
-            vboPos[i * 2] = glm::vec3(p1->position.x, p1->position.y, p1->position.z);
-            vboPos[i * 2 + 1] = glm::vec3(p2->position.x, p2->position.y, p2->position.z);
-            vboNor[i * 2] = glm::vec3(p1->normal.x, p1->normal.y, p1->normal.z);
-            vboNor[i * 2 + 1] = glm::vec3(p2->normal.x, p2->normal.y, p2->normal.z);
+        for (int i = 0; i < numSprings * 2; i++) {
+            vboPos[i] = particles->getPosition(lineIndices[i]);
+            vboNor[i] = particles->getNormal(lineIndices[i]);
         }
 
         /** Build shader program **/
@@ -329,13 +336,9 @@ public:
 
     void Update()
     {
-        for (int i = 0; i < numSprings; i++) {
-            Particle* p1 = springs[i]->p1;
-            Particle* p2 = springs[i]->p2;
-            vboPos[i * 2] = glm::vec3(p1->position.x, p1->position.y, p1->position.z);
-            vboPos[i * 2 + 1] = glm::vec3(p2->position.x, p2->position.y, p2->position.z);
-            vboNor[i * 2] = glm::vec3(p1->normal.x, p1->normal.y, p1->normal.z);
-            vboNor[i * 2 + 1] = glm::vec3(p2->normal.x, p2->normal.y, p2->normal.z);
+        for (int i = 0; i < numSprings * 2; i++) {
+            vboPos[i] = particles->getPosition(lineIndices[i]);
+            vboNor[i] = particles->getNormal(lineIndices[i]);
         }
 
         glUseProgram(programID);
@@ -380,7 +383,7 @@ public:
     {
         cloth = clothArg;
         springColor = glm::vec4(1.0, 1.0, 1.0, 1.0);
-        springRenderer = new SpringRenderer(cloth->springs, springColor, glm::vec3(cloth->clothPos.x, cloth->clothPos.y, cloth->clothPos.z));
+        springRenderer = new SpringRenderer(&cloth->particles, cloth->springBatches, springColor, glm::vec3(cloth->clothPos.x, cloth->clothPos.y, cloth->clothPos.z));
     }
 
     void Update() { springRenderer->Update(); }
@@ -0,0 +1,182 @@
+#pragma once
+#include "Spring.hpp"
+
+// Symmetric 3x3 matrix, the Jacobian block of one spring
+struct SymMat3
+{
+    double xx, yy, zz, xy, xz, yz;
+
+    vec3 operator*(vec3 v)
+    {
+        return vec3(xx * v.x + xy * v.y + xz * v.z, xy * v.x + yy * v.y + yz * v.z, xz * v.x + yz * v.y + zz * v.z);
+    }
+};
+
+// Backward Euler step after Baraff & Witkin, "Large Steps in Cloth Simulation": the spring forces are
+// linearized around the current state and (M - h D - h^2 K) dv = h (f + h K v) is solved for the
+// velocity change, with K & D the spring force Jacobians in position & velocity. The solve is
+// matrix-free conjugate gradients with a Jacobi preconditioner: the system only exists as one 3x3
+// block per spring. Pinned particles (invMass 0) are filtered out of the solve and keep their velocity.
+// Large steps stay stable for stiff springs, at the price of extra damping.
+class ImplicitIntegrator
+{
+public:
+    int maxIterations = 100;
+    double tolerance = 1e-3; // residual norm relative to the right-hand side
+    int iterations = 0; // CG iterations of the last step
+
+    // particles.force holds the forces at the current state (e.g. from Cloth::computeForces); they are
+    // cleared like the explicit integrator does
+    void step(Particles& particles, std::vector<SpringBatch*>& batches, double deltaT, ThreadPool* pool = NULL)
+    {
+        int n = particles.size();
+        double h = deltaT;
+        rhs.resize(n);
+        diag.resize(n);
+        for (int i = 0; i < n; i++) {
+            rhs[i] = particles.force[i] * h;
+            diag[i] = vec3(particles.mass[i], particles.mass[i], particles.mass[i]);
+        }
+        /** Spring Jacobian blocks, their part of the right-hand side & the preconditioner **/
+        blocks.resize(batches.size());
+        for (int b = 0; b < batches.size(); b++) {
+            SpringBatch* batch = batches[b];
+            blocks[b].resize(batch->size());
+            forEachColor(batch, pool, [&](int begin, int end) {
+                buildBlocks(particles, batch, blocks[b], begin, end, h);
+            });
+        }
+        filter(particles, rhs);
+
+        /** Preconditioned conjugate gradients, warm started from the last step's dv **/
+        if (dv.size() != n) dv.assign(n, vec3());
+        filter(particles, dv);
+        multiply(particles, batches, dv, product, pool);
+        residual.resize(n);
+        for (int i = 0; i < n; i++) residual[i] = rhs[i] - product[i];
+        direction.resize(n);
+        preconditioned.resize(n);
+        for (int i = 0; i < n; i++) direction[i] = precondition(i, residual[i]);
+        double rz = dot(residual, direction);
+        double stopNorm2 = tolerance * tolerance * dot(rhs, rhs);
+        iterations = 0;
+        while (iterations < maxIterations && dot(residual, residual) > stopNorm2) {
+            multiply(particles, batches, direction, product, pool);
+            double pq = dot(direction, product);
+            if (pq <= 0.0) break; // not positive definite any more, keep what we have
+            double alpha = rz / pq;
+            for (int i = 0; i < n; i++) {
+                dv[i] += direction[i] * alpha;
+                residual[i] -= product[i] * alpha;
+            }
+            double rzNew = 0.0;
+            for (int i = 0; i < n; i++) {
+                preconditioned[i] = precondition(i, residual[i]);
+                rzNew += vec3::dot(residual[i], preconditioned[i]);
+            }
+            double beta = rzNew / rz;
+            for (int i = 0; i < n; i++) direction[i] = preconditioned[i] + direction[i] * beta;
+            rz = rzNew;
+            iterations++;
+        }
+
+        /** Integrate with the new velocities **/
+        for (int i = 0; i < n; i++) {
+            particles.velocity[i] += dv[i];
+            particles.position[i] += particles.velocity[i] * h;
+            particles.force[i].setAsZero();
+        }
+    }
+
+private:
+    std::vector<std::vector<SymMat3>> blocks; // h^2 K + h D block of every spring, per batch
+    std::vector<vec3> rhs, diag, residual, direction, product, preconditioned;
+    std::vector<vec3> dv; // solution, kept as the next step's first guess
+
+    // func(begin, end) over each color of the batch in turn, split over the pool
+    template <typename Func>
+    void forEachColor(SpringBatch* batch, ThreadPool* pool, Func func)
+    {
+        for (int c = 0; c + 1 < batch->colorStart.size(); c++) {
+            int first = batch->colorStart[c];
+            parallelFor(pool, batch->colorStart[c + 1] - first, [&](int begin, int end, int /*thread*/) {
+                func(first + begin, first + end);
+            }, 2048);
+        }
+    }
+
+    void buildBlocks(Particles& particles, SpringBatch* batch, std::vector<SymMat3>& block, int begin, int end, double h)
+    {
+        double Ks = batch->params->Ks;
+        double Kd = batch->params->Kd;
+        for (int s = begin; s < end; s++) {
+            int p1 = batch->p1[s];
+            int p2 = batch->p2[s];
+            vec3 d = particles.position[p2] - particles.position[p1];
+            double len = d.length();
+            if (len == 0.0) {
+                // collapsed spring: no direction to linearize along, so it stays out of the system
+                block[s] = SymMat3();
+                continue;
+            }
+            vec3 u = d / len;
+            // dF/dx = Ks (u u^T + (1 - L0 / L) (I - u u^T)); the transverse term is dropped while the
+            // spring is compressed, where it would make the system indefinite
+            double transverse = 1.0 - batch->restLen[s] / len;
+            if (transverse < 0.0) transverse = 0.0;
+            double a = Ks * transverse;       // coefficient of I
+            double c = Ks * (1.0 - transverse); // coefficient of u u^T
+            SymMat3 J = { a + c * u.x * u.x, a + c * u.y * u.y, a + c * u.z * u.z, c * u.x * u.y, c * u.x * u.z, c * u.y * u.z };
+            // right-hand side h^2 K v: +J (v2 - v1) on p1, the opposite on p2
+            vec3 f = J * (particles.velocity[p2] - particles.velocity[p1]) * (h * h);
+            rhs[p1] += f;
+            rhs[p2] -= f;
+            // h^2 J + h Kd u u^T
+            double hd = h * Kd;
+            SymMat3 S = { h * h * J.xx + hd * u.x * u.x, h * h * J.yy + hd * u.y * u.y, h * h * J.zz + hd * u.z * u.z,
+                h * h * J.xy + hd * u.x * u.y, h * h * J.xz + hd * u.x * u.z, h * h * J.yz + hd * u.y * u.z };
+            block[s] = S;
+            diag[p1] += vec3(S.xx, S.yy, S.zz);
+            diag[p2] += vec3(S.xx, S.yy, S.zz);
+        }
+    }
+
+    // out = (M - h D - h^2 K) in, filtered
+    void multiply(Particles& particles, std::vector<SpringBatch*>& batches, std::vector<vec3>& in, std::vector<vec3>& out, ThreadPool* pool)
+    {
+        int n = particles.size();
+        out.resize(n);
+        for (int i = 0; i < n; i++) out[i] = in[i] * particles.mass[i];
+        for (int b = 0; b < batches.size(); b++) {
+            SpringBatch* batch = batches[b];
+            std::vector<SymMat3>& block = blocks[b];
+            forEachColor(batch, pool, [&](int begin, int end) {
+                for (int s = begin; s < end; s++) {
+                    int p1 = batch->p1[s];
+                    int p2 = batch->p2[s];
+                    vec3 f = block[s] * (in[p1] - in[p2]);
+                    out[p1] += f;
+                    out[p2] -= f;
+                }
+            });
+        }
+        filter(particles, out);
+    }
+
+    // Pinned particles take no part in the solve
+    void filter(Particles& particles, std::vector<vec3>& v)
+    {
+        for (int i = 0; i < v.size(); i++) {
+            if (particles.isPinned(i)) v[i].setAsZero();
+        }
+    }
+
+    vec3 precondition(int i, vec3 r) { return vec3(r.x / diag[i].x, r.y / diag[i].y, r.z / diag[i].z); }
+
+    double dot(std::vector<vec3>& a, std::vector<vec3>& b)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < a.size(); i++) sum += vec3::dot(a[i], b[i]);
+        return sum;
+    }
+};
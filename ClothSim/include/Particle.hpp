@@ -13,48 +13,68 @@ struct Vertex  // for ground & sphere which are fixed
     }
 };
 
-class Particle
+// Cloth particle state as contiguous component arrays: particle i is element i of each array,
+// so passes over the cloth stream through memory instead of chasing one heap object per particle.
+// invMass 0 pins a particle; forces then leave it where it is without a branch in the integrator.
+struct Particles
 {
-public:
-    double mass;
-    bool isFixed;
-    vec3 position;
-    vec3 initPosition;
-    vec3 normal;
-    vec2 texCoord;
-    vec3 force;
-    vec3 acceleration;
-    vec3 velocity;
+    std::vector<double> mass;
+    std::vector<double> invMass;
+    std::vector<vec3> position;
+    std::vector<vec3> initPosition;
+    std::vector<vec3> normal;
+    std::vector<vec2> texCoord;
+    std::vector<vec3> force;
+    std::vector<vec3> velocity;
+
+    int size() { return (int)position.size(); }
 
-    Particle(vec3 pos)
+    int add(vec3 pos, double m = 1.0)
     {
-        mass = 1.0;
-        isFixed = false;
-        position = pos;
-        initPosition = pos;
-        normal.setAsZero();
-        force.setAsZero();
-        acceleration.setAsZero();
-        velocity.setAsZero();
+        mass.push_back(m);
+        invMass.push_back(1.0 / m);
+        position.push_back(pos);
+        initPosition.push_back(pos);
+        normal.push_back(vec3());
+        texCoord.push_back(vec2());
+        force.push_back(vec3());
+        velocity.push_back(vec3());
+        return size() - 1;
     }
 
-    void applyForce(vec3 forceArg) { force += forceArg; }
+    // Float copies for the renderers' vertex buffers
+    glm::vec3 getPosition(int i) { return glm::vec3(position[i].x, position[i].y, position[i].z); }
+    glm::vec3 getNormal(int i) { return glm::vec3(normal[i].x, normal[i].y, normal[i].z); }
+    glm::vec2 getTexCoord(int i) { return glm::vec2(texCoord[i].x, texCoord[i].y); }
+
+    bool isPinned(int i) { return invMass[i] == 0.0; }
+
+    void pin(int i)
+    {
+        invMass[i] = 0.0;
+        velocity[i].setAsZero(); // would otherwise carry a pinned particle along
+    }
+
+    void unpin(int i) { invMass[i] = 1.0 / mass[i]; }
+
+    void applyForce(int i, vec3 forceArg) { force[i] += forceArg; }
 
     void integrateMotion(double deltaT)
     {
-        if (!isFixed) { // only update unfixed particles
-            acceleration = force / mass;
-            velocity += acceleration * deltaT;
-            position += velocity * deltaT;
+        int n = size();
+        for (int i = 0; i < n; i++) {
+            velocity[i] += force[i] * invMass[i] * deltaT;
+            position[i] += velocity[i] * deltaT;
+            force[i].setAsZero(); // after applying forces, it becomes zero and need updated next frame
         }
-        force.setAsZero(); // after applying forces, it becomes zero and need updated next frame
     }
 
     void reset()
     {
         position = initPosition;
-        force.setAsZero();
-        acceleration.setAsZero();
-        velocity.setAsZero();
+        for (int i = 0; i < size(); i++) {
+            force[i].setAsZero();
+            velocity[i].setAsZero();
+        }
     }
 };
@@ -1,33 +1,137 @@
 #pragma once
 #include "Particle.hpp"
+#include "ThreadPool.hpp"
 
-class Spring
+// Greedy coloring of elements (springs, triangles) touching arity particles each, indices[e * arity + k],
+// such that no two elements of a color share a particle: one color can then add its forces from many
+// threads without races, and going color by color keeps the sums identical for any thread count.
+// Returns the elements grouped by color, order[new] = old (file order within a color), and the first
+// new element of each color in colorStart, plus an end entry.
+inline std::vector<int> colorElements(const std::vector<int>& indices, int arity, int numParticles, std::vector<int>& colorStart)
 {
-public:
-    Particle* p1, *p2;
-    double restLen; // Spring rest length L0;
-    // Hooke coefficient Ks, the spring constant describing the <stiffness> of the spring
-    // Damping constant Kd, representing the resistence of moving close
-    // Should be specified according to spring types: strctural, shear, or bending
-    double Ks;
-    double Kd;
-
-    Spring(Particle* p1Arg, Particle* p2Arg, double stiffness, double damping)
+    int numElements = indices.size() / arity;
+    std::vector<unsigned long long> usedColors(numParticles, 0); // bit c: touched by an element of color c
+    std::vector<int> color(numElements);
+    int numColors = 0;
+    for (int e = 0; e < numElements; e++) {
+        unsigned long long used = 0;
+        for (int k = 0; k < arity; k++) used |= usedColors[indices[e * arity + k]];
+        int c = 0;
+        while (c < 64 && (used >> c & 1)) c++;
+        if (c < 64) {
+            for (int k = 0; k < arity; k++) usedColors[indices[e * arity + k]] |= 1ull << c;
+        }
+        else {
+            c = 64 + e; // out of mask bits: a color of its own is always safe
+        }
+        color[e] = c;
+        if (c + 1 > numColors) numColors = c + 1;
+    }
+    // Counting sort by color, dropping colors nobody took
+    std::vector<int> count(numColors + 1, 0);
+    for (int e = 0; e < numElements; e++) count[color[e] + 1]++;
+    for (int c = 0; c < numColors; c++) count[c + 1] += count[c];
+    std::vector<int> order(numElements);
+    for (int e = 0; e < numElements; e++) order[count[color[e]]++] = e;
+    colorStart.clear();
+    for (int e = 0; e < numElements; e++) {
+        if (e == 0 || color[order[e]] != color[order[e - 1]]) colorStart.push_back(e);
+    }
+    colorStart.push_back(numElements);
+    return order;
+}
+
+// Hooke coefficient Ks, the spring constant describing the <stiffness> of the spring
+// Damping constant Kd, representing the resistence of moving close
+// Should be specified according to spring types: strctural, shear, or bending
+struct SpringParams
+{
+    float Ks;
+    float Kd;
+};
+
+// All springs of one type as parallel arrays of particle indices & rest lengths.
+// Ks & Kd are read from the shared SpringParams on every pass, so edits apply on the next substep.
+// After colorSprings the springs are grouped by color (see colorElements).
+struct SpringBatch
+{
+    SpringParams* params;
+    std::vector<int> p1, p2; // particle indices
+    std::vector<double> restLen; // Spring rest length L0;
+    std::vector<int> colorStart = { 0 }; // springs of color c: [colorStart[c], colorStart[c + 1])
+    std::vector<vec3> f1; // force on p1 of each spring, scratch for applyForces
+
+    SpringBatch(SpringParams* paramsArg) { params = paramsArg; }
+
+    int size() { return (int)p1.size(); }
+
+    void add(Particles& particles, int p1Arg, int p2Arg)
+    {
+        p1.push_back(p1Arg);
+        p2.push_back(p2Arg);
+        restLen.push_back(vec3::dist(particles.position[p1Arg], particles.position[p2Arg]));
+        colorStart.assign({ 0, size() });
+    }
+
+    void colorSprings(int numParticles)
     {
-        p1 = p1Arg;
-        p2 = p2Arg;
-        restLen = vec3::dist(p1->position, p2->position);
-        Ks = stiffness;
-        Kd = damping;
+        std::vector<int> indices;
+        for (int i = 0; i < size(); i++) {
+            indices.push_back(p1[i]);
+            indices.push_back(p2[i]);
+        }
+        std::vector<int> order = colorElements(indices, 2, numParticles, colorStart);
+        std::vector<double> oldRestLen = restLen;
+        for (int i = 0; i < size(); i++) {
+            p1[i] = indices[2 * order[i]];
+            p2[i] = indices[2 * order[i] + 1];
+            restLen[i] = oldRestLen[order[i]];
+        }
     }
 
-    void applyForce()
+    // One color at a time, each split over the pool (serially if NULL)
+    void applyForces(Particles& particles, ThreadPool* pool = NULL)
     {
-        double currLen = vec3::dist(p1->position, p2->position);
-        vec3 f1Dir = vec3::getNormalized(p2->position - p1->position); // direction of force on p1;
-        double vCloseNeg = vec3::dot((p2->velocity - p1->velocity), f1Dir);
-        vec3 f1 = f1Dir * (Ks * (currLen - restLen) + Kd * vCloseNeg);
-        p1->applyForce(f1);
-        p2->applyForce(f1.negative());
+        f1.resize(size());
+        for (int c = 0; c + 1 < colorStart.size(); c++) {
+            int first = colorStart[c];
+            parallelFor(pool, colorStart[c + 1] - first, [&](int begin, int end, int /*thread*/) {
+                applyForces(particles, first + begin, first + end);
+            }, 2048);
+        }
+    }
+
+    // Springs [begin, end), which must not share particles with springs other threads run
+    void applyForces(Particles& particles, int begin, int end)
+    {
+        double Ks = params->Ks;
+        double Kd = params->Kd;
+        const vec3* position = particles.position.data();
+        const vec3* velocity = particles.velocity.data();
+        vec3* force = particles.force.data();
+
+        // Spring forces first: no writes to particles, so the loop vectorizes
+        for (int i = begin; i < end; i++) {
+            const vec3& x1 = position[p1[i]];
+            const vec3& x2 = position[p2[i]];
+            double dx = x2.x - x1.x;
+            double dy = x2.y - x1.y;
+            double dz = x2.z - x1.z;
+            double currLen = sqrt(dx * dx + dy * dy + dz * dz);
+            double invLen = currLen > 0.0 ? 1.0 / currLen : 0.0; // a collapsed spring has no direction, so no force
+            dx *= invLen; // direction of force on p1
+            dy *= invLen;
+            dz *= invLen;
+            const vec3& v1 = velocity[p1[i]];
+            const vec3& v2 = velocity[p2[i]];
+            double vCloseNeg = (v2.x - v1.x) * dx + (v2.y - v1.y) * dy + (v2.z - v1.z) * dz;
+            double f = Ks * (currLen - restLen[i]) + Kd * vCloseNeg;
+            f1[i] = vec3(dx * f, dy * f, dz * f);
+        }
+        // Then scattered to both ends
+        for (int i = begin; i < end; i++) {
+            force[p1[i]] += f1[i];
+            force[p2[i]] -= f1[i];
+        }
     }
 };
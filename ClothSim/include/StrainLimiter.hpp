@@ -0,0 +1,135 @@
+#pragma once
+#include "Spring.hpp"
+#include <algorithm>
+
+// Post-integration strain limiting after Provot, "Deformation Constraints in a Mass-Spring Model to
+// Describe Rigid Cloth Behavior": springs stretched beyond (1 + maxStretch) L0 are pulled back to that
+// length, both ends moving by their inverse mass, a few Gauss-Seidel sweeps color by color as in
+// XPBDSolver. Long range attachments (Kim et al., "Long Range Attachments - A Method to Simulate
+// Inextensible Clothing in Computer Games") then keep every free particle within (1 + maxStretch) times
+// its rest distance of its nearest pinned particles, which a few local sweeps alone cannot do across the
+// cloth.
+// Limited springs & tethers also lose the part of their velocity that stretches them further (an
+// inelastic impulse), so the pass never adds energy, even when it snaps a large violation back.
+class StrainLimiter
+{
+public:
+    int numIterations = 2;
+    double maxStretch = 0.05; // largest L / L0 - 1 left after the pass
+    bool useTethers = true;
+    int tethersPerParticle = 2; // nearest pinned particles each free one is tethered to
+
+    int numTethers() { return (int)tetherAnchor.size(); }
+
+    // Tethers from every free particle to its tethersPerParticle nearest pinned ones (nearest first), as
+    // long as their distance in initPosition (the flat cloth, where it is also the geodesic one), so there
+    // are O(particles) of them however many pins there are; rebuild whenever the pins change
+    void buildTethers(Particles& particles)
+    {
+        int n = particles.size();
+        std::vector<int> anchors;
+        for (int i = 0; i < n; i++) {
+            if (particles.isPinned(i)) anchors.push_back(i);
+        }
+        int k = std::min(tethersPerParticle, (int)anchors.size());
+        std::vector<int> nearest(k);
+        std::vector<double> nearestLen(k);
+        tetherStart.assign(1, 0);
+        tetherAnchor.clear();
+        tetherLen.clear();
+        for (int i = 0; i < n; i++) {
+            if (!particles.isPinned(i)) {
+                // insertion into the k nearest so far, kept sorted
+                int numNearest = 0;
+                for (int a = 0; a < anchors.size(); a++) {
+                    double len = vec3::dist(particles.initPosition[i], particles.initPosition[anchors[a]]);
+                    if (numNearest == k && len >= nearestLen[k - 1]) continue;
+                    int j = numNearest < k ? numNearest++ : k - 1;
+                    for (; j > 0 && nearestLen[j - 1] > len; j--) {
+                        nearest[j] = nearest[j - 1];
+                        nearestLen[j] = nearestLen[j - 1];
+                    }
+                    nearest[j] = anchors[a];
+                    nearestLen[j] = len;
+                }
+                tetherAnchor.insert(tetherAnchor.end(), nearest.begin(), nearest.begin() + numNearest);
+                tetherLen.insert(tetherLen.end(), nearestLen.begin(), nearestLen.begin() + numNearest);
+            }
+            tetherStart.push_back((int)tetherAnchor.size());
+        }
+    }
+
+    void apply(Particles& particles, std::vector<SpringBatch*>& batches, ThreadPool* pool = NULL)
+    {
+        int n = particles.size();
+        /** Springs **/
+        for (int k = 0; k < numIterations; k++) {
+            for (int b = 0; b < batches.size(); b++) {
+                SpringBatch* batch = batches[b];
+                for (int c = 0; c + 1 < batch->colorStart.size(); c++) {
+                    int first = batch->colorStart[c];
+                    parallelFor(pool, batch->colorStart[c + 1] - first, [&](int begin, int end, int /*thread*/) {
+                        limitSprings(particles, batch, first + begin, first + end);
+                    }, 2048);
+                }
+            }
+        }
+        /** Tethers, each particle only moves itself **/
+        if (useTethers && tetherStart.size() == n + 1) {
+            parallelFor(pool, n, [&](int begin, int end, int /*thread*/) {
+                limitTethers(particles, begin, end);
+            }, 2048);
+        }
+    }
+
+private:
+    std::vector<int> tetherStart; // tethers of particle i: [tetherStart[i], tetherStart[i + 1])
+    std::vector<int> tetherAnchor; // pinned particle at the other end
+    std::vector<double> tetherLen; // rest distance to it
+
+    // Springs [begin, end) of the batch, which must not share particles with ones other threads run
+    void limitSprings(Particles& particles, SpringBatch* batch, int begin, int end)
+    {
+        std::vector<vec3>& position = particles.position;
+        std::vector<vec3>& velocity = particles.velocity;
+        for (int s = begin; s < end; s++) {
+            int p1 = batch->p1[s];
+            int p2 = batch->p2[s];
+            double w1 = particles.invMass[p1];
+            double w2 = particles.invMass[p2];
+            if (w1 + w2 == 0.0) continue;
+            vec3 d = position[p2] - position[p1];
+            double len = d.length();
+            double maxLen = (1.0 + maxStretch) * batch->restLen[s];
+            if (len <= maxLen) continue;
+            vec3 u = d / len;
+            double excess = (len - maxLen) / (w1 + w2);
+            position[p1] += u * (w1 * excess);
+            position[p2] -= u * (w2 * excess);
+            double vStretch = vec3::dot(velocity[p2] - velocity[p1], u) / (w1 + w2);
+            if (vStretch > 0.0) {
+                velocity[p1] += u * (w1 * vStretch);
+                velocity[p2] -= u * (w2 * vStretch);
+            }
+        }
+    }
+
+    void limitTethers(Particles& particles, int begin, int end)
+    {
+        std::vector<vec3>& position = particles.position;
+        std::vector<vec3>& velocity = particles.velocity;
+        for (int i = begin; i < end; i++) {
+            if (particles.invMass[i] == 0.0) continue; // held still for now (see Cloth::holdSleepingParticles)
+            for (int t = tetherStart[i]; t < tetherStart[i + 1]; t++) {
+                vec3 d = position[i] - position[tetherAnchor[t]];
+                double len = d.length();
+                double maxLen = (1.0 + maxStretch) * tetherLen[t];
+                if (len <= maxLen) continue;
+                vec3 u = d / len;
+                position[i] -= u * (len - maxLen);
+                double vStretch = vec3::dot(velocity[i], u); // pinned particles stand still
+                if (vStretch > 0.0) velocity[i] -= u * vStretch;
+            }
+        }
+    }
+};
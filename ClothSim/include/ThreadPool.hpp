@@ -0,0 +1,104 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running one parallel loop at a time. The loop is cut into one
+// contiguous chunk per thread (the calling thread takes the first), so with no shared writes
+// inside a loop its results do not depend on timing.
+class ThreadPool
+{
+public:
+    typedef std::function<void(int, int, int)> RangeFunc; // (begin, end, thread)
+
+    // numThreads counts the calling thread; 0 uses one per hardware thread
+    ThreadPool(int numThreads = 0)
+    {
+        if (numThreads <= 0) numThreads = std::thread::hardware_concurrency();
+        if (numThreads <= 0) numThreads = 1;
+        for (int t = 1; t < numThreads; t++) {
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this, t));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        wake.notify_all();
+        for (int t = 0; t < workers.size(); t++) workers[t].join();
+    }
+
+    int size() { return (int)workers.size() + 1; }
+
+    // Run func over [0, n), split over at most size() threads with at least minChunk items each;
+    // returns when every chunk is done
+    void parallelFor(int n, const RangeFunc& func, int minChunk = 1)
+    {
+        int numChunks = minChunk > 0 ? n / minChunk : n;
+        if (numChunks > size()) numChunks = size();
+        if (numChunks <= 1) {
+            if (n > 0) func(0, n, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &func;
+            jobSize = n;
+            jobChunks = numChunks;
+            pendingChunks = numChunks - 1;
+            generation++;
+        }
+        wake.notify_all();
+        runChunk(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pendingChunks == 0; });
+        job = NULL;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake; // a new loop or shutdown
+    std::condition_variable done; // the last worker chunk finished
+    const RangeFunc* job = NULL;
+    int jobSize = 0;
+    int jobChunks = 0;
+    int pendingChunks = 0;
+    int generation = 0;
+    bool isStopping = false;
+
+    void runChunk(int chunk)
+    {
+        int begin = (int)((long long)jobSize * chunk / jobChunks);
+        int end = (int)((long long)jobSize * (chunk + 1) / jobChunks);
+        (*job)(begin, end, chunk);
+    }
+
+    void workerLoop(int thread)
+    {
+        int seenGeneration = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return isStopping || generation != seenGeneration; });
+            if (isStopping) return;
+            seenGeneration = generation;
+            if (thread >= jobChunks) continue; // loop too small to need this thread
+            lock.unlock();
+            runChunk(thread);
+            lock.lock();
+            if (--pendingChunks == 0) done.notify_one();
+        }
+    }
+};
+
+// pool->parallelFor, or func over the whole range on this thread if pool is NULL
+inline void parallelFor(ThreadPool* pool, int n, const ThreadPool::RangeFunc& func, int minChunk = 1)
+{
+    if (pool) pool->parallelFor(n, func, minChunk);
+    else if (n > 0) func(0, n, 0);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+
+// Lock-free triple buffer between one writer & one reader thread: the writer fills back() and
+// publishes it, the reader switches to the newest published slot with update(), and neither ever
+// waits for the other. The three slots trade places by index through one atomic, so a slot is
+// only copied into when written.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer: the slot to fill, not seen by the reader until publish
+    T& back() { return slots[backIndex]; }
+
+    // Writer: back() becomes the newest slot; a free one takes its place
+    void publish()
+    {
+        int old = ready.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+        backIndex = old & INDEX;
+    }
+
+    // Reader: switch front() to the newest slot, if one was published since the last switch
+    bool update()
+    {
+        if (!(ready.load(std::memory_order_acquire) & FRESH)) return false;
+        int old = ready.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & INDEX;
+        return true;
+    }
+
+    // Reader: the slot taken by the last update
+    T& front() { return slots[frontIndex]; }
+
+private:
+    static const int INDEX = 3; // low bits of ready: a slot index
+    static const int FRESH = 4; // set while ready holds a slot the reader has not taken yet
+    T slots[3];
+    int backIndex = 0; // writer's own
+    int frontIndex = 1; // reader's own
+    std::atomic<int> ready{ 2 }; // the slot in between
+};
@@ -81,8 +81,8 @@ struct vec3
 
     static vec3 getNormalized(vec3 v)
     {
-        double w = v.length();
-        return vec3(v.x / w, v.y / w, v.z / w);
+        double invW = 1.0 / v.length(); // one division instead of three
+        return vec3(v.x * invW, v.y * invW, v.z * invW);
     }
 
     static double dot(vec3 v1, vec3 v2)
@@ -92,7 +92,11 @@ struct vec3
 
     static double dist(vec3 v1, vec3 v2)
     {
-        return sqrt(pow(v1.x - v2.x, 2) + pow(v1.y - v2.y, 2) + pow(v1.z - v2.z, 2));
+        // plain products, pow() is a library call per component
+        double dx = v1.x - v2.x;
+        double dy = v1.y - v2.y;
+        double dz = v1.z - v2.z;
+        return sqrt(dx * dx + dy * dy + dz * dz);
     }
 
     vec3 negative()
@@ -161,9 +165,10 @@ struct vec3
         double w = length();
         if (w < 0.00001) return;
 
-        x /= w;
-        y /= w;
-        z /= w;
+        double invW = 1.0 / w;
+        x *= invW;
+        y *= invW;
+        z *= invW;
     }
 
     void setAsZero() {
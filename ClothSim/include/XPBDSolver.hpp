@@ -0,0 +1,162 @@
+#pragma once
+#include "Spring.hpp"
+#include <algorithm>
+
+// Extended position based dynamics (Macklin et al., "XPBD: Position-Based Simulation of Compliant
+// Constrained Dynamics"): every spring becomes a distance constraint C = |x2 - x1| - L0 with
+// compliance 1 / Ks, so it converges to the same equilibrium as the mass-spring model, and Kd maps to
+// XPBD constraint damping. Positions are predicted from the other forces, then projected
+// onto the constraints; velocities follow from the position change. Pinned particles (invMass 0)
+// never move.
+// Gauss-Seidel goes color by color (see colorElements), so it runs in parallel and gives the same
+// result for any thread count. Jacobi under-relaxes every constraint by the number of constraints on
+// its busier particle (scaled by jacobiRelaxation), and the multiplier takes the same scaled step as
+// the positions.
+// Chebyshev acceleration (Wang, "A Chebyshev Semi-Iterative Approach for Accelerating Projective
+// and Position-based Dynamics") extrapolates the iterates, mainly useful for Jacobi.
+class XPBDSolver
+{
+public:
+    enum IterationEnum {
+        GAUSS_SEIDEL,
+        JACOBI,
+    };
+    IterationEnum iteration = GAUSS_SEIDEL;
+    int numIterations = 20;
+    double jacobiRelaxation = 1.5; // scale of the under-relaxed Jacobi corrections
+    bool useChebyshev = false;
+    double spectralRadius = 0.9; // estimated convergence rate of the plain iteration, for the Chebyshev weights
+    double maxStrain = 0.0; // largest |L - L0| / L0 after the last step
+
+    // particles.force holds the forces besides the springs; they are cleared like the explicit integrator does
+    void step(Particles& particles, std::vector<SpringBatch*>& batches, double deltaT, ThreadPool* pool = NULL)
+    {
+        int n = particles.size();
+        double h = deltaT;
+        /** Predict positions from the other forces **/
+        prevPosition = particles.position;
+        for (int i = 0; i < n; i++) {
+            particles.velocity[i] += particles.force[i] * particles.invMass[i] * h;
+            particles.position[i] += particles.velocity[i] * h;
+            particles.force[i].setAsZero();
+        }
+        lambdas.resize(batches.size());
+        for (int b = 0; b < batches.size(); b++) lambdas[b].assign(batches[b]->size(), 0.0);
+        if (iteration == JACOBI) countConstraints(particles, batches);
+
+        /** Project onto the constraints **/
+        double omega = 1.0;
+        for (int k = 0; k < numIterations; k++) {
+            if (useChebyshev) {
+                currIterate = particles.position;
+                currLambdas = lambdas;
+            }
+            if (iteration == JACOBI) corrections.assign(n, vec3());
+            for (int b = 0; b < batches.size(); b++) {
+                SpringBatch* batch = batches[b];
+                for (int c = 0; c + 1 < batch->colorStart.size(); c++) {
+                    int first = batch->colorStart[c];
+                    parallelFor(pool, batch->colorStart[c + 1] - first, [&](int begin, int end, int /*thread*/) {
+                        solveConstraints(particles, batch, lambdas[b], first + begin, first + end, h);
+                    }, 2048);
+                }
+            }
+            if (iteration == JACOBI) {
+                for (int i = 0; i < n; i++) particles.position[i] += corrections[i];
+            }
+            if (useChebyshev) {
+                // x(k+1) = omega (x^(k+1) - x(k-1)) + x(k-1), from the second iteration on
+                double rho2 = spectralRadius * spectralRadius;
+                omega = k == 0 ? 1.0 : (k == 1 ? 2.0 / (2.0 - rho2) : 4.0 / (4.0 - rho2 * omega));
+                if (k > 0) {
+                    for (int i = 0; i < n; i++) {
+                        particles.position[i] = (particles.position[i] - prevIterate[i]) * omega + prevIterate[i];
+                    }
+                    // the multipliers too, or they no longer match the positions
+                    for (int b = 0; b < lambdas.size(); b++) {
+                        for (int s = 0; s < lambdas[b].size(); s++) {
+                            lambdas[b][s] = (lambdas[b][s] - prevLambdas[b][s]) * omega + prevLambdas[b][s];
+                        }
+                    }
+                }
+                prevIterate.swap(currIterate);
+                prevLambdas.swap(currLambdas);
+            }
+        }
+
+        /** Velocities from the position change **/
+        for (int i = 0; i < n; i++) {
+            particles.velocity[i] = (particles.position[i] - prevPosition[i]) / h;
+        }
+        maxStrain = 0.0;
+        for (int b = 0; b < batches.size(); b++) {
+            SpringBatch* batch = batches[b];
+            for (int s = 0; s < batch->size(); s++) {
+                double len = vec3::dist(particles.position[batch->p1[s]], particles.position[batch->p2[s]]);
+                double strain = fabs(len - batch->restLen[s]) / batch->restLen[s];
+                if (strain > maxStrain) maxStrain = strain;
+            }
+        }
+    }
+
+private:
+    std::vector<std::vector<double>> lambdas; // accumulated multiplier of every constraint, per batch
+    std::vector<vec3> prevPosition; // positions at the start of the step
+    std::vector<vec3> corrections; // Jacobi: summed corrections per particle
+    std::vector<int> numConstraints; // Jacobi: constraints acting on each particle
+    std::vector<vec3> prevIterate, currIterate; // Chebyshev: positions of the last two iterations
+    std::vector<std::vector<double>> prevLambdas, currLambdas; // Chebyshev: multipliers of the last two iterations
+
+    void countConstraints(Particles& particles, std::vector<SpringBatch*>& batches)
+    {
+        numConstraints.assign(particles.size(), 0);
+        for (int b = 0; b < batches.size(); b++) {
+            SpringBatch* batch = batches[b];
+            if (batch->params->Ks <= 0.0) continue;
+            for (int s = 0; s < batch->size(); s++) {
+                int p1 = batch->p1[s];
+                int p2 = batch->p2[s];
+                if (particles.invMass[p1] + particles.invMass[p2] == 0.0) continue;
+                numConstraints[p1]++;
+                numConstraints[p2]++;
+            }
+        }
+    }
+
+    // Constraints [begin, end) of the batch, which must not share particles with ones other threads run
+    void solveConstraints(Particles& particles, SpringBatch* batch, std::vector<double>& lambda, int begin, int end, double h)
+    {
+        double Ks = batch->params->Ks;
+        if (Ks <= 0.0) return;
+        double alpha = 1.0 / (Ks * h * h); // time-step scaled compliance
+        double gamma = batch->params->Kd / (Ks * h); // alpha * (h^2 Kd) / h
+        std::vector<vec3>& position = particles.position;
+        for (int s = begin; s < end; s++) {
+            int p1 = batch->p1[s];
+            int p2 = batch->p2[s];
+            double w1 = particles.invMass[p1];
+            double w2 = particles.invMass[p2];
+            if (w1 + w2 == 0.0) continue;
+            vec3 d = position[p2] - position[p1];
+            double len = d.length();
+            if (len == 0.0) continue;
+            vec3 u = d / len; // gradient of C at p2, -u at p1
+            double C = len - batch->restLen[s];
+            // damping acts on the constraint's rate over the step so far
+            double rate = vec3::dot(u, (position[p2] - prevPosition[p2]) - (position[p1] - prevPosition[p1]));
+            double dLambda = (-C - alpha * lambda[s] - gamma * rate) / ((1.0 + gamma) * (w1 + w2) + alpha);
+            if (iteration == JACOBI) {
+                // the scaled step is what reaches the positions, so it is also all the multiplier takes
+                dLambda *= jacobiRelaxation / std::max(numConstraints[p1], numConstraints[p2]);
+                lambda[s] += dLambda;
+                corrections[p1] -= u * (w1 * dLambda);
+                corrections[p2] += u * (w2 * dLambda);
+            }
+            else {
+                lambda[s] += dLambda;
+                position[p1] -= u * (w1 * dLambda);
+                position[p2] += u * (w2 * dLambda);
+            }
+        }
+    }
+};
@@ -1,5 +1,5 @@
 #define STB_IMAGE_IMPLEMENTATION
-#include "Cloth.hpp"
+#include "ClothSimulator.hpp"
 #include "Display.hpp"
 #include "../imgui/imgui.h"
 #include "../imgui/imgui_impl_glfw.h"
@@ -54,8 +54,6 @@ float fanMoveSpeed = 0.05f;
 bool isFanUseColor = false;
 bool isFanTransparent = true;
 // wind
-double airDensity = 1.255;
-double airDragCoeff = 1.28; 
 float vWindVal = -0.0001;
 vec3 windDir = cloth.clothPos - fanPos;
 vec3 vWind = vWindVal * windDir;
@@ -68,8 +66,11 @@ vec3 grabForce;
 
 /** Window & World **/
 // Simulation
-int simFreq = 30; // simulation times per frame, gravity should be divided by this
-double deltaT = 0.01;
+ThreadPool threadPool; // runs the cloth's force passes
+// Owns the cloth once started: steps it on its own thread, takes edits as posted commands and publishes
+// snapshots for the renderer
+ClothSimulator simulator(&cloth, &ground, &orb, &threadPool);
+ClothSettings settings = simulator.getSettings(); // the control panel's copy, posted on every change
 // window1
 const char* windowIconFile = "assets/windowIcon1.png";
 const char* windowTitle = "Randal's Magic Cloth";
@@ -84,7 +85,6 @@ GLFWwindow* window;
 //int windowHeight2 = 1200;
 //glm::vec4 bgColor2 = { 20.0f / 255, 20.0f / 255, 50.0f / 255, 0.95f };
 //GLFWwindow* window2;
-vec3 gravity(0.0, -9.8 / simFreq, 0.0);
 
 /** ImGUI Panel **/
 bool isPaused = false;
@@ -104,6 +104,7 @@ bool isGrabing = false; // if mouse left button is down
 GLFWwindow* createWindow(const char* windowTitle, const char* windowIconFile, int width, int height);
 // object movement keymaps
 void moveClothKeymap(GLFWwindow* window);
+void postClothTransform(const char* trsfInstruction);
 void moveCameraKeymap(GLFWwindow* window);
 void moveLightKeymap(GLFWwindow* window);
 void moveWindKeymap(GLFWwindow* window);
@@ -165,12 +166,12 @@ int main(int argc, const char* argv[])
     ImGui_ImplOpenGL3_Init("#version 330");
 
     // Create Renderers
-    ClothRenderer clothRenderer1(&cloth, clothTexFilename1);
-    ClothRenderer clothRenderer2(&cloth, clothTexFilename2);
-    ClothRenderer clothRenderer3(&cloth, clothTexFilename3);
-    ClothRenderer clothRenderer4(&cloth, clothTexFilename4);
-    ClothRenderer clothRenderer5(&cloth, clothTexFilename5);
-    ClothRenderer clothRenderer6(&cloth, clothTexFilename6);
+    ClothRenderer clothRenderer1(&cloth, &simulator.snapshots, clothTexFilename1);
+    ClothRenderer clothRenderer2(&cloth, &simulator.snapshots, clothTexFilename2);
+    ClothRenderer clothRenderer3(&cloth, &simulator.snapshots, clothTexFilename3);
+    ClothRenderer clothRenderer4(&cloth, &simulator.snapshots, clothTexFilename4);
+    ClothRenderer clothRenderer5(&cloth, &simulator.snapshots, clothTexFilename5);
+    ClothRenderer clothRenderer6(&cloth, &simulator.snapshots, clothTexFilename6);
     ClothRenderer currClothRenderer = clothRenderer1;
     int currClothTex = 1;
     GroundRenderer groundRenderer(&ground, groundTexFilename);
@@ -181,6 +182,9 @@ int main(int argc, const char* argv[])
     glEnable(GL_DEPTH_TEST);
     glPointSize(3);
 
+    settings.vWind = vWind;
+    simulator.start(settings);
+
     /** -------------------------------- Rendering loop -------------------------------- **/
     while (!glfwWindowShouldClose(window))
     {
@@ -194,15 +198,30 @@ int main(int argc, const char* argv[])
 
         {
             ImGui::Begin("Control Panel");
+            ClothSnapshot& snapshot = simulator.snapshots.front(); // the frame on screen
+            bool isEdited = false; // post settings at the end
             // FPS
             ImGui::Text("Simulate with %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+            ImGui::Text("Solver throughput: %.0f steps/s (%d particles)", snapshot.substepsPerSecond, (int)snapshot.position.size());
+            ImGui::Text("Solver cost: %.2f ms per simulated second", snapshot.wallPerSimSecond);
             /** General **/
             // Pause
-            ImGui::Checkbox("Pause Simulation", &isPaused);
+            isEdited |= ImGui::Checkbox("Pause Simulation", &isPaused);
+            settings.isPaused = isPaused;
+            // Time stepping
+            isEdited |= ImGui::Checkbox("Adaptive Time Step", &settings.isAdaptiveStep);
+            if (settings.isAdaptiveStep) isEdited |= ImGui::SliderFloat("time scale", &settings.timeScale, 1.0f, 30.0f);
+            ImGui::Text("Substeps: %d of %.4f s", snapshot.numSteps, snapshot.stepT);
+            // Sleeping
+            isEdited |= ImGui::Checkbox("Sleeping", &settings.useSleeping);
+            ImGui::SameLine();
+            ImGui::Text("(%d of %d tiles active)", snapshot.numAwakeTiles, snapshot.numTiles);
             // Reset
+            static int appliedPinMode = 0; // last pin mode posted
             bool isResetPushed = ImGui::Button("Reset", ImVec2(100, 60));
             if (isResetPushed) { 
-                cloth.reset(); 
+                simulator.post([] { cloth.reset(); });
+                appliedPinMode = -1; // reset re-pins the cloth, post the pin mode again
             }
 
             /** Cloth **/
@@ -216,6 +235,12 @@ int main(int argc, const char* argv[])
                 isGrabAllowed = false;
                 moveClothKeymap(window);
             }
+            // spring forces from the grid stencil or the spring batches
+            isEdited |= ImGui::Checkbox("Grid Stencil Springs", &settings.useGridStencil);
+            // force passes on all threads, or only the simulation one
+            isEdited |= ImGui::Checkbox("Parallel Forces", &settings.isParallelForces);
+            ImGui::SameLine();
+            ImGui::Text("(%d threads)", threadPool.size());
             // load different texture
             static int selectedTex = 0;
             std::vector<const char*> textures = { 
@@ -263,18 +288,23 @@ int main(int argc, const char* argv[])
             ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.5);
             ImGui::Combo("Change Pin Mode", &selectedPinMode, pinModes.data(), pinModes.size());
             ImGui::PopItemWidth();
-            if (pinModes[selectedPinMode] == "Pin Upper Corner" && cloth.pinMode != "Pin Upper Corner") {
-                cloth.pinMode = "Pin Upper Corner";
-                cloth.updatePinMode();
+            if (pinModes[selectedPinMode] == "Pin Upper Corner" && appliedPinMode != selectedPinMode) {
+                simulator.post([] {
+                    cloth.pinMode = "Pin Upper Corner";
+                    cloth.updatePinMode();
+                });
             }
-            if (pinModes[selectedPinMode] == "Pin Upper Edge" && cloth.pinMode != "Pin Upper Edge") {
-                cloth.pinMode = "Pin Upper Edge";
-                cloth.updatePinMode();
+            if (pinModes[selectedPinMode] == "Pin Upper Edge" && appliedPinMode != selectedPinMode) {
+                simulator.post([] {
+                    cloth.pinMode = "Pin Upper Edge";
+                    cloth.updatePinMode();
+                });
             }
-            if (pinModes[selectedPinMode] == "Drop Cloth" && cloth.pinMode != "Drop Cloth") {
-                cloth.dropCloth();
+            if (pinModes[selectedPinMode] == "Drop Cloth" && appliedPinMode != selectedPinMode) {
+                simulator.post([] { cloth.dropCloth(); });
             }
-            // change draw mode
+            appliedPinMode = selectedPinMode;
+            // change draw mode, only read by the renderer
             static int selectedDrawMode = 2;
             std::vector<const char*> drawModes = {
                 "Draw Particles",
@@ -295,17 +325,63 @@ int main(int argc, const char* argv[])
             }
             // change spring parameters
             ImGui::Text("Hooke coefficient Ks");
-            ImGui::SliderFloat("structural Ks", &(cloth.structuralStiffness), 500.0f, 5000.0f);
-            ImGui::SliderFloat("shearing Ks", &(cloth.shearStiffness), 20.0f, 500.0f);
-            ImGui::SliderFloat("bending Ks", &(cloth.bendingStiffness), 100.0f, 1000.0f);
+            isEdited |= ImGui::SliderFloat("structural Ks", &(settings.structuralParams.Ks), 50.0f, 5000.0f);
+            isEdited |= ImGui::SliderFloat("shearing Ks", &(settings.shearParams.Ks), 20.0f, 500.0f);
+            isEdited |= ImGui::SliderFloat("bending Ks", &(settings.bendingParams.Ks), 20.0f, 1000.0f);
             ImGui::Text("Damping constant Kd");
-            ImGui::SliderFloat("structural Kd", &(cloth.structuralDamping), 10.0f, 100.0f);
-            ImGui::SliderFloat("shearing Kd", &(cloth.shearDamping), 0.0f, 5.0f);
-            ImGui::SliderFloat("bending Kd", &(cloth.bendingDamping), 0.0f, 50.0f);
+            isEdited |= ImGui::SliderFloat("structural Kd", &(settings.structuralParams.Kd), 10.0f, 100.0f);
+            isEdited |= ImGui::SliderFloat("shearing Kd", &(settings.shearParams.Kd), 0.0f, 5.0f);
+            isEdited |= ImGui::SliderFloat("bending Kd", &(settings.bendingParams.Kd), 0.0f, 50.0f);
+            // cap spring stretch after each step, so softer springs need fewer substeps
+            isEdited |= ImGui::Checkbox("Strain Limiting", &settings.useStrainLimit);
+            if (settings.useStrainLimit) {
+                float maxStretch = settings.maxStretch * 100.0;
+                if (ImGui::SliderFloat("max stretch %", &maxStretch, 1.0f, 20.0f)) {
+                    settings.maxStretch = maxStretch / 100.0;
+                    isEdited = true;
+                }
+                isEdited |= ImGui::Checkbox("Tethers", &settings.useTethers);
+                ImGui::SameLine();
+                ImGui::Text("(%d to pinned particles)", snapshot.numTethers);
+            }
+            // change integrator
+            static int selectedSolver = 0;
+            std::vector<const char*> solvers = {
+                "Explicit Euler",
+                "Implicit Euler",
+                "XPBD",
+            };
+            ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.5);
+            isEdited |= ImGui::Combo("Change Solver", &selectedSolver, solvers.data(), solvers.size());
+            ImGui::PopItemWidth();
+            if (solvers[selectedSolver] == "Explicit Euler") {
+                settings.solver = Cloth::SOLVER_EXPLICIT;
+            }
+            if (solvers[selectedSolver] == "Implicit Euler") {
+                settings.solver = Cloth::SOLVER_IMPLICIT;
+                isEdited |= ImGui::SliderInt("steps per frame", &settings.largeStepsPerFrame, 1, 8);
+                ImGui::Text("CG iterations: %d", snapshot.cgIterations);
+            }
+            if (solvers[selectedSolver] == "XPBD") {
+                settings.solver = Cloth::SOLVER_XPBD;
+                isEdited |= ImGui::SliderInt("steps per frame", &settings.largeStepsPerFrame, 1, 8);
+                isEdited |= ImGui::SliderInt("iterations", &settings.xpbdIterations, 1, 200);
+                static int selectedIteration = 0;
+                std::vector<const char*> iterations = {
+                    "Gauss-Seidel",
+                    "Jacobi",
+                };
+                ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.5);
+                isEdited |= ImGui::Combo("Iteration", &selectedIteration, iterations.data(), iterations.size());
+                ImGui::PopItemWidth();
+                settings.xpbdIteration = selectedIteration == 0 ? XPBDSolver::GAUSS_SEIDEL : XPBDSolver::JACOBI;
+                isEdited |= ImGui::Checkbox("Chebyshev Acceleration", &settings.useChebyshev);
+                ImGui::Text("Max spring strain: %.2f%%", snapshot.maxStrain * 100.0);
+            }
             // friction
             ImGui::Text("\nFriction");
-            ImGui::SliderFloat("cloth @ orb", &(orb.restitution), 0.0f, 1.0f);
-            ImGui::SliderFloat("cloth @ ground", &(ground.restitution), 0.0f, 1.0f);
+            isEdited |= ImGui::SliderFloat("cloth @ orb", &(settings.orbRestitution), 0.0f, 1.0f);
+            isEdited |= ImGui::SliderFloat("cloth @ ground", &(settings.groundRestitution), 0.0f, 1.0f);
 
             /** Light **/
             ImGui::Text("\nLight");
@@ -352,6 +428,10 @@ int main(int argc, const char* argv[])
             // update wind
             windDir = cloth.clothPos - fanPos;
             vWind = vWindVal * windDir;
+            if (vWind != settings.vWind) {
+                settings.vWind = vWind;
+                isEdited = true;
+            }
 
             /** User Grab **/
             ImGui::Text("\nMouse Grab");
@@ -376,6 +456,7 @@ int main(int argc, const char* argv[])
                 moveCameraKeymap(window);
             }
 
+            if (isEdited) simulator.post(settings);
             ImGui::End();
         }
         
@@ -385,16 +466,6 @@ int main(int argc, const char* argv[])
         glClearColor(bgColor.x, bgColor.y, bgColor.z, 1.0); // Set color value (R,G,B,A) - Set Status
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        /** Simulation **/
-        if (!isPaused) {
-            for (int i = 0; i < simFreq; i++) {
-                cloth.computeForces(gravity, airDensity, airDragCoeff, vWind);
-                cloth.integrateMotion(deltaT);
-                cloth.collisionResponse(&ground, &orb);
-            }
-            cloth.updateNormal();
-        }
-
         /** Rendering **/
         currClothRenderer.Update();
         orbRenderer.Update();
@@ -406,6 +477,7 @@ int main(int argc, const char* argv[])
 
         glfwSwapBuffers(window);
     }
+    simulator.stop();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -485,7 +557,8 @@ void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
             grabDir = vec3(xpos, -ypos, 0) - grabStartPos;
             grabDir.normalize();
             grabForce = grabDir * grabForceVal;
-            cloth.addGrabForce(grabForce);
+            vec3 force = grabForce;
+            simulator.post([force] { cloth.addGrabForce(force); });
         }
     }
 }
@@ -494,31 +567,37 @@ void moveClothKeymap(GLFWwindow* window)
 {
     /** Cloth control : [W] [S] [A] [D] [Q] [E] [Z] [C]**/
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Up", clothMoveSpeed);
+        postClothTransform("Up");
     }
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Down", clothMoveSpeed);
+        postClothTransform("Down");
     }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Left", clothMoveSpeed);
+        postClothTransform("Left");
     }
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Right", clothMoveSpeed);
+        postClothTransform("Right");
     }
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Inward", clothMoveSpeed);
+        postClothTransform("Inward");
     }
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Outward", clothMoveSpeed);
+        postClothTransform("Outward");
     }
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Rotate Counterclockwise", clothMoveSpeed);
+        postClothTransform("Rotate Counterclockwise");
     }
     if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && (!isPaused)) {
-        cloth.transform("Rotate Clockwise", clothMoveSpeed);
+        postClothTransform("Rotate Clockwise");
     }
 }
 
+void postClothTransform(const char* trsfInstruction)
+{
+    float moveSpeed = clothMoveSpeed;
+    simulator.post([trsfInstruction, moveSpeed] { cloth.transform(trsfInstruction, moveSpeed); });
+}
+
 void moveCameraKeymap(GLFWwindow* window)
 {
     /** Camera control : [W] [S] [A] [D] [Q] [E] **/
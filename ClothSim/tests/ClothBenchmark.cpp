@@ -0,0 +1,155 @@
+// Timings of the default scene (cloth pinned at the upper corners falling onto the orb, with wind):
+// - substeps per second, stepped like ClothSimulator without adaptive stepping (simFreq explicit
+//   substeps of deltaT per frame), serially and on a ThreadPool; the pool only shows a speedup with
+//   more than one hardware thread, on a single one it measures the pool's overhead
+// - wall time per simulated second of each solver at the steps the simulator takes with adaptive
+//   stepping: explicit Euler at the largest stable step, implicit Euler at largeStepsPerFrame steps
+// Each case is run a few times from the start and the median is printed. Sleeping is off, so a
+// settled cloth still costs full price.
+//
+// Build from ClothSim/ (console program, no window or GL context needed), e.g.
+//   g++ -O2 -std=c++17 -pthread -I include tests/ClothBenchmark.cpp -o ClothBenchmark
+//   cl /O2 /EHsc /std:c++17 /I include tests\ClothBenchmark.cpp
+#include "Cloth.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    const int simFreq = 30;
+    const double deltaT = 0.01;
+    const int numRuns = 5;
+    // ClothSimulator defaults: each 60 FPS frame simulates timeScale / 60 s
+    const double frameSimT = 18.0 / 60;
+    const int largeStepsPerFrame = 2;
+    const double stepSafety = 0.9;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Scene
+    {
+        vec3 clothPos = vec3(-3, 8, -2);
+        Cloth cloth;
+        Ground ground = Ground(vec3(-5, 1, 2), vec2(10, 10), 0.6f);
+        Sphere orb = Sphere(1.5f, vec3(0, 4, -2), 0.8f);
+        vec3 gravity = vec3(0.0, -9.8 / simFreq, 0.0);
+        vec3 vWind;
+
+        Scene(double size, ThreadPool* threadPool) : cloth(clothPos, vec2(size, size), "Pin Upper Corner")
+        {
+            cloth.threadPool = threadPool;
+            cloth.useSleeping = false;
+            vec3 fanPos(2, 7, 3);
+            vec3 windDir = clothPos - fanPos;
+            vWind = -0.0001 * windDir;
+        }
+
+        void step(double stepT)
+        {
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            cloth.integrateMotion(stepT);
+            cloth.collisionResponse(&ground, &orb);
+        }
+    };
+
+    double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    // Median substeps per second over numRuns fresh cloths of size x size units
+    double substepsPerSecond(double size, int numFrames, ThreadPool* threadPool)
+    {
+        std::vector<double> rates;
+        for (int run = 0; run < numRuns; run++) {
+            Scene scene(size, threadPool);
+            Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < numFrames; frame++) {
+                for (int i = 0; i < simFreq; i++) scene.step(deltaT);
+                scene.cloth.updateNormal();
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            rates.push_back(numFrames * simFreq / seconds);
+        }
+        return median(rates);
+    }
+
+    struct SolverTiming
+    {
+        double msPerSimSecond;
+        double stepsPerFrame;
+        double cgIterations; // per step, implicit Euler only
+    };
+
+    // Median ms of wall time per simulated second over numRuns fresh cloths, numFrames frames each
+    SolverTiming solverTiming(Cloth::SolverEnum solver, double size, int numFrames)
+    {
+        std::vector<double> times;
+        SolverTiming timing = {};
+        for (int run = 0; run < numRuns; run++) {
+            Scene scene(size, NULL);
+            scene.cloth.solver = solver;
+            int numSteps = 0;
+            long cgIterations = 0;
+            Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < numFrames; frame++) {
+                // as ClothSimulator::simulateFrame does with adaptive stepping
+                double springT = stepSafety * scene.cloth.springTimeStep();
+                double simT = 0.0;
+                while (simT < frameSimT - 1e-9) {
+                    double stepT = frameSimT / largeStepsPerFrame;
+                    if (solver == Cloth::SOLVER_EXPLICIT) {
+                        double stableT = std::min(springT, stepSafety * scene.cloth.speedTimeStep());
+                        double restT = frameSimT - simT;
+                        stepT = restT / ceil(restT / stableT);
+                    }
+                    scene.step(stepT);
+                    cgIterations += scene.cloth.implicitIntegrator.iterations;
+                    simT += stepT;
+                    numSteps++;
+                }
+                scene.cloth.updateNormal();
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            times.push_back(1000.0 * seconds / (numFrames * frameSimT));
+            timing.stepsPerFrame = (double)numSteps / numFrames;
+            timing.cgIterations = solver == Cloth::SOLVER_IMPLICIT ? (double)cgIterations / numSteps : 0.0;
+        }
+        timing.msPerSimSecond = median(times);
+        return timing;
+    }
+}
+
+int main()
+{
+    ThreadPool threadPool;
+    int numHardwareThreads = std::thread::hardware_concurrency();
+    bool isScaling = numHardwareThreads > 1;
+    struct { double size; int numFrames; } scenes[] = { { 6, 100 }, { 24, 10 } };
+    printf("explicit Euler, %d substeps of %g s per frame, median of %d runs (hardware threads: %d, pool size: %d)\n",
+        simFreq, deltaT, numRuns, numHardwareThreads, threadPool.size());
+    if (!isScaling) printf("(one hardware thread: serial vs pool is the pool's overhead, not a speedup)\n");
+    for (auto& scene : scenes) {
+        int n = (int)(scene.size * 5); // particleDensity
+        double serial = substepsPerSecond(scene.size, scene.numFrames, NULL);
+        double parallel = substepsPerSecond(scene.size, scene.numFrames, &threadPool);
+        printf("%3dx%-3d cloth: %8.0f substeps/s serial, %8.0f on the thread pool", n, n, serial, parallel);
+        if (isScaling) printf(": %.2fx", parallel / serial);
+        printf("\n");
+    }
+
+    printf("\nwall time per simulated second, %g s frames, serial, median of %d runs\n", frameSimT, numRuns);
+    for (auto& scene : scenes) {
+        int n = (int)(scene.size * 5);
+        int numFrames = std::max(scene.numFrames / 10, 2);
+        SolverTiming explicitEuler = solverTiming(Cloth::SOLVER_EXPLICIT, scene.size, numFrames);
+        SolverTiming implicitEuler = solverTiming(Cloth::SOLVER_IMPLICIT, scene.size, numFrames);
+        printf("%3dx%-3d cloth: explicit %8.1f ms (%5.1f steps/frame), implicit %8.1f ms (%d steps/frame, %.1f CG iterations/step): %.1fx\n",
+            n, n, explicitEuler.msPerSimSecond, explicitEuler.stepsPerFrame, implicitEuler.msPerSimSecond, largeStepsPerFrame,
+            implicitEuler.cgIterations, explicitEuler.msPerSimSecond / implicitEuler.msPerSimSecond);
+    }
+    return 0;
+}
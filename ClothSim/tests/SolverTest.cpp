@@ -0,0 +1,206 @@
+// Checks of the cloth solvers on the default cloth, headless. Exits with 1 if a check fails.
+// - Collapsed spring: two neighbouring particles moved onto the same point must leave every
+//   particle finite after a few steps, and the rest of the cloth moving from the first step on,
+//   with each solver
+// - Equilibrium strain: a cloth hung from its upper edge comes to rest with the same spring strains
+//   under XPBD (Gauss-Seidel, Jacobi with & without Chebyshev, iterated to convergence) as under
+//   explicit Euler, i.e. the compliance 1 / Ks gives the mass-spring stiffness
+// - Grid stencil: forces of the default cloth, a few steps into the fall, are the same from the grid
+//   stencil (useGridStencil) as from the spring batches, to rounding
+// - Thread count: a 120x120 cloth stepped serially and on pools of 4 and 7 threads ends up with the same
+//   positions bit for bit, with each solver (the pool splits the loops even on fewer cores)
+// - Tether count: a 120x120 cloth pinned along its upper edge gets at most tethersPerParticle tethers
+//   per particle, not one per pinned particle
+//
+// Build from ClothSim/ (console program, no window or GL context needed), e.g.
+//   g++ -O2 -std=c++17 -pthread -I include tests/SolverTest.cpp -o SolverTest
+//   cl /O2 /EHsc /std:c++17 /I include tests\SolverTest.cpp
+#include "Cloth.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    const char* solverNames[] = { "explicit Euler", "implicit Euler", "XPBD" };
+
+    bool isFinite(Particles& particles)
+    {
+        for (int i = 0; i < particles.size(); i++) {
+            vec3& p = particles.position[i];
+            vec3& v = particles.velocity[i];
+            if (!std::isfinite(p.x + p.y + p.z) || !std::isfinite(v.x + v.y + v.z)) return false;
+        }
+        return true;
+    }
+
+    bool collapsedSpring(Cloth::SolverEnum solver)
+    {
+        vec3 clothPos(-3, 8, -2);
+        Cloth cloth(clothPos, vec2(6, 6), "Pin Upper Corner");
+        cloth.solver = solver;
+        vec3 gravity(0.0, -9.8 / 30, 0.0);
+        vec3 fanPos(2, 7, 3);
+        vec3 windDir = clothPos - fanPos;
+        vec3 vWind = -0.0001 * windDir; // the scene's wind (the drag divides by the air speed)
+        int i = cloth.getIndex(cloth.numRows / 2, cloth.numCols / 2);
+        cloth.particles.position[i + 1] = cloth.particles.position[i]; // their structural spring has length 0
+        int corner = cloth.getIndex(cloth.numRows - 1, cloth.numCols - 1); // a free particle, far away
+        vec3 cornerStart = cloth.particles.position[corner];
+        bool isMoving = true;
+        for (int step = 0; step < 3; step++) {
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            cloth.integrateMotion(solver == Cloth::SOLVER_EXPLICIT ? 0.01 : 0.15);
+            // NaN forces can also stall a solve (CG stops at once), leaving the whole cloth where it was
+            if (step == 0) isMoving = vec3::dist(cloth.particles.position[corner], cornerStart) > 1e-6;
+        }
+        bool isOk = isFinite(cloth.particles) && isMoving;
+        printf("collapsed spring, %-14s: %s\n", solverNames[solver],
+            !isFinite(cloth.particles) ? "NaN FAILED" : isMoving ? "finite, moving" : "cloth stuck FAILED");
+        return isOk;
+    }
+
+    // Strain L / L0 - 1 of every structural spring once a 3x3 cloth, pinned along its upper edge where
+    // init put it, hangs still. Velocities are damped on top of the solver to settle faster; no force
+    // depends on the velocity at rest, so the rest state stays the same.
+    std::vector<double> restStrains(Cloth::SolverEnum solver, double deltaT, XPBDSolver::IterationEnum iteration, int numIterations, bool useChebyshev)
+    {
+        vec3 clothPos(-3, 8, -2);
+        Cloth cloth(clothPos, vec2(3, 3), "Pin Upper Corner");
+        for (int col = 0; col < cloth.numCols; col++) cloth.PinParticle(0, col, vec3());
+        cloth.solver = solver;
+        cloth.xpbdSolver.iteration = iteration;
+        cloth.xpbdSolver.numIterations = numIterations;
+        cloth.xpbdSolver.useChebyshev = useChebyshev;
+        cloth.useStrainLimit = false; // would cap the strain
+        cloth.useSleeping = false;
+        vec3 gravity(0.0, -9.8 / 30, 0.0);
+        vec3 fanPos(2, 7, 3);
+        vec3 windDir = clothPos - fanPos;
+        vec3 vWind = -0.0001 * windDir;
+        double keep = pow(0.1, deltaT); // a tenth of the velocity left after each second
+        int numSteps = (int)(30.0 / deltaT);
+        for (int step = 0; step < numSteps; step++) {
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            cloth.integrateMotion(deltaT);
+            for (int i = 0; i < cloth.particles.size(); i++) cloth.particles.velocity[i] *= keep;
+        }
+        std::vector<double> strains;
+        SpringBatch& springs = cloth.structuralSprings;
+        for (int s = 0; s < springs.size(); s++) {
+            double len = vec3::dist(cloth.particles.position[springs.p1[s]], cloth.particles.position[springs.p2[s]]);
+            strains.push_back(len / springs.restLen[s] - 1.0);
+        }
+        return strains;
+    }
+
+    bool gridStencil()
+    {
+        vec3 clothPos(-3, 8, -2);
+        Cloth cloth(clothPos, vec2(6, 6), "Pin Upper Corner");
+        vec3 gravity(0.0, -9.8 / 30, 0.0);
+        vec3 fanPos(2, 7, 3);
+        vec3 windDir = clothPos - fanPos;
+        vec3 vWind = -0.0001 * windDir;
+        for (int step = 0; step < 30; step++) {
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            cloth.integrateMotion(0.01);
+        }
+        std::vector<vec3> forces[2];
+        for (int useGridStencil = 0; useGridStencil < 2; useGridStencil++) {
+            cloth.useGridStencil = useGridStencil;
+            for (int i = 0; i < cloth.particles.size(); i++) cloth.particles.force[i].setAsZero();
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            forces[useGridStencil] = cloth.particles.force;
+        }
+        double maxForce = 0.0, maxDiff = 0.0;
+        for (int i = 0; i < cloth.particles.size(); i++) {
+            maxForce = std::max(maxForce, forces[0][i].length());
+            maxDiff = std::max(maxDiff, vec3::dist(forces[0][i], forces[1][i]));
+        }
+        bool isOk = maxDiff <= 1e-9 * maxForce;
+        printf("grid stencil vs spring batches: off by %.2g of %.2g: %s\n", maxDiff, maxForce, isOk ? "ok" : "FAILED");
+        return isOk;
+    }
+
+    std::vector<vec3> steppedPositions(Cloth::SolverEnum solver, ThreadPool* threadPool)
+    {
+        vec3 clothPos(-3, 8, -2);
+        Cloth cloth(clothPos, vec2(24, 24), "Pin Upper Corner");
+        cloth.solver = solver;
+        cloth.threadPool = threadPool;
+        vec3 gravity(0.0, -9.8 / 30, 0.0);
+        vec3 fanPos(2, 7, 3);
+        vec3 windDir = clothPos - fanPos;
+        vec3 vWind = -0.0001 * windDir;
+        bool isExplicit = solver == Cloth::SOLVER_EXPLICIT;
+        for (int step = 0; step < (isExplicit ? 30 : 4); step++) {
+            cloth.computeForces(gravity, 1.255, 1.28, vWind);
+            cloth.integrateMotion(isExplicit ? 0.01 : 0.15);
+        }
+        return cloth.particles.position;
+    }
+
+    bool threadCount(Cloth::SolverEnum solver)
+    {
+        std::vector<vec3> serial = steppedPositions(solver, NULL);
+        bool isOk = true;
+        for (int numThreads : { 4, 7 }) {
+            ThreadPool threadPool(numThreads);
+            std::vector<vec3> parallel = steppedPositions(solver, &threadPool);
+            isOk &= memcmp(serial.data(), parallel.data(), serial.size() * sizeof(vec3)) == 0;
+        }
+        printf("thread count, %-14s: %s\n", solverNames[solver], isOk ? "identical" : "differs FAILED");
+        return isOk;
+    }
+
+    bool tetherCount()
+    {
+        Cloth cloth(vec3(-3, 8, -2), vec2(24, 24), "Pin Upper Edge");
+        int n = cloth.particles.size();
+        int maxTethers = cloth.strainLimiter.tethersPerParticle * n;
+        int numTethers = cloth.strainLimiter.numTethers();
+        bool isOk = numTethers > 0 && numTethers <= maxTethers;
+        printf("tether count, %d particles pinned along an edge: %d tethers (at most %d): %s\n", n, numTethers,
+            maxTethers, isOk ? "ok" : "FAILED");
+        return isOk;
+    }
+
+    bool equilibriumStrain()
+    {
+        std::vector<double> reference = restStrains(Cloth::SOLVER_EXPLICIT, 0.01, XPBDSolver::GAUSS_SEIDEL, 0, false);
+        double maxStrain = *std::max_element(reference.begin(), reference.end());
+        struct { const char* name; double deltaT; XPBDSolver::IterationEnum iteration; int numIterations; bool useChebyshev; } cases[] = {
+            { "XPBD Gauss-Seidel", 0.15, XPBDSolver::GAUSS_SEIDEL, 100, false },
+            { "XPBD Jacobi", 0.05, XPBDSolver::JACOBI, 300, false },
+            { "XPBD Jacobi, Chebyshev", 0.05, XPBDSolver::JACOBI, 100, true },
+        };
+        bool isOk = true;
+        for (auto& c : cases) {
+            std::vector<double> strains = restStrains(Cloth::SOLVER_XPBD, c.deltaT, c.iteration, c.numIterations, c.useChebyshev);
+            double maxDiff = 0.0;
+            for (int s = 0; s < strains.size(); s++) maxDiff = std::max(maxDiff, fabs(strains[s] - reference[s]));
+            bool isClose = maxDiff < 0.01 * maxStrain;
+            printf("equilibrium strain, %-22s (%d iterations, %g s steps): off by %.2g of %.2g: %s\n", c.name,
+                c.numIterations, c.deltaT, maxDiff, maxStrain, isClose ? "ok" : "FAILED");
+            isOk &= isClose;
+        }
+        return isOk;
+    }
+}
+
+int main()
+{
+    bool isPassed = true;
+    for (Cloth::SolverEnum solver : { Cloth::SOLVER_EXPLICIT, Cloth::SOLVER_IMPLICIT, Cloth::SOLVER_XPBD }) {
+        isPassed &= collapsedSpring(solver);
+    }
+    isPassed &= gridStencil();
+    for (Cloth::SolverEnum solver : { Cloth::SOLVER_EXPLICIT, Cloth::SOLVER_IMPLICIT, Cloth::SOLVER_XPBD }) {
+        isPassed &= threadCount(solver);
+    }
+    isPassed &= equilibriumStrain();
+    isPassed &= tetherCount();
+    return isPassed ? 0 : 1;
+}